@@ -0,0 +1,52 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// kolejka zdarzeń - jeden pisarz, jeden czytelnik, bez blokad i bez sterty (bufor pierścieniowy)
+// pisarz nigdy nie czeka: przy pełnej kolejce push zwraca false, a zdarzenie przepada (licznik dropped)
+// T musi być trywialnie kopiowalne, Size - potęga dwójki
+
+template <typename T, size_t Size>
+class EventQueue
+{
+  static_assert(Size > 0 and (Size & (Size - 1)) == 0, "Size must be a power of two");
+
+public:
+  bool push(const T& event)
+  { // tylko pisarz
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == Size)
+    {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    items_[head & (Size - 1)] = event;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T* event)
+  { // tylko czytelnik
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) return false;
+    *event = items_[tail & (Size - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t dropped() const
+  {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> dropped_{0};
+  T items_[Size] = {};
+};
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef FLASH_JOURNAL_H
+#define FLASH_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "hal.h"
+
+// dziennik rekordów w obszarze flash (halJournal*) - pierścień sektorów z równomiernym zużyciem:
+// rekordy dopisywane kolejno do skasowanych komórek, sektor kasowany przy ponownym wejściu pierścienia
+// albo wcześniej przez prepare() - kasowanie wstrzymuje pamięć podręczną flash obu rdzeni, więc wywołujący
+// kasuje z wyprzedzeniem, gdy nic nie wymaga dokładnego czasu, a append kasuje tylko po wyczerpaniu zapasu
+// każdy rekord ma numer kolejny i CRC - rekord przerwany utratą zasilania jest pomijany przy odczycie
+// T musi być trywialnie kopiowalne, zapisy z jednego zadania
+
+template <typename T>
+class FlashJournal
+{
+public:
+  bool begin()
+  { // odszukanie najnowszego rekordu - następny zapis trafia za niego
+    uint32_t size = halJournalBegin();
+    sectorSize_ = halJournalSectorSize();
+    perSector_ = sectorSize_ > 0 ? sectorSize_ / sizeof(Frame) : 0;
+    slots_ = perSector_ > 0 ? size / sectorSize_ * perSector_ : 0;
+    sequence_ = 0;
+    next_ = 0;
+    ready_ = 0;
+    if (slots_ == 0) return false;
+
+    Frame frame;
+    for (uint32_t slot = 0; slot < slots_; slot++)
+    {
+      if (readSlot(slot, &frame) and valid(frame) and frame.sequence > sequence_)
+      {
+        sequence_ = frame.sequence;
+        next_ = (slot + 1) % slots_;
+      }
+    }
+    // sektory skasowane przed restartem - bez ponownego kasowania (zużycie flash)
+    uint32_t sectors = slots_ / perSector_;
+    while (sectors >= 3 and ready_ < sectors - 2 and sectorErased((enterSector() + ready_) % sectors)) ready_++;
+    return true;
+  }
+
+  template <typename F>
+  void replay(F visit)
+  { // rekordy od najstarszego do najnowszego - pierścień od miejsca następnego zapisu
+    Frame frame;
+    for (uint32_t i = 0; i < slots_; i++)
+    {
+      if (readSlot((next_ + i) % slots_, &frame) and valid(frame)) visit(frame.value);
+    }
+  }
+
+  bool sectorStart() const
+  { // kolejny zapis wchodzi do najstarszego sektora
+    return slots_ > 0 and next_ % perSector_ == 0;
+  }
+
+  bool prepare(uint32_t ahead)
+  { // skasowanie kolejnego sektora przed wejściem pierścienia - najwyżej ahead sektorów zapasu,
+    // zawsze zostaje bieżący sektor i co najmniej jeden pełny sektor historii; zwraca true, jeżeli kasowało
+    uint32_t sectors = perSector_ > 0 ? slots_ / perSector_ : 0;
+    if (sectors < 3 or ready_ >= ahead or ready_ >= sectors - 2) return false;
+    if (!halJournalErase((enterSector() + ready_) % sectors)) return false;
+    ready_++;
+    return true;
+  }
+
+  bool append(const T& value)
+  {
+    if (slots_ == 0) return false;
+    Frame frame;
+    memset(&frame, 0, sizeof(frame)); // wyzerowane wyrównanie - CRC liczone po bajtach
+    frame.sequence = sequence_ + 1;
+    frame.value = value;
+    frame.crc = crc16(&frame, offsetof(Frame, crc));
+
+    for (uint32_t tries = 0; tries <= perSector_; tries++)
+    {
+      uint32_t slot = next_;
+      next_ = (slot + 1) % slots_;
+      if (slot % perSector_ == 0)
+      { // wejście do sektora - skasowanego przez prepare albo kasowanego teraz
+        if (ready_ > 0) ready_--;
+        else if (!halJournalErase(slot / perSector_)) return false;
+      }
+      if (!erased(slot)) continue; // pozostałość zapisu przerwanego utratą zasilania
+      if (!halJournalWrite(offset(slot), &frame, sizeof(frame))) return false;
+      sequence_ = frame.sequence;
+      return true;
+    }
+    return false;
+  }
+
+private:
+  struct Frame
+  {
+    uint32_t sequence;
+    T value;
+    uint16_t crc;
+  };
+
+  uint32_t enterSector() const
+  { // najbliższy sektor, do którego wejdzie pierścień
+    uint32_t sector = next_ / perSector_;
+    return next_ % perSector_ == 0 ? sector : (sector + 1) % (slots_ / perSector_);
+  }
+
+  uint32_t offset(uint32_t slot) const
+  { // rekordy nie przekraczają granicy sektora
+    return slot / perSector_ * sectorSize_ + slot % perSector_ * sizeof(Frame);
+  }
+
+  bool readSlot(uint32_t slot, Frame* frame) const
+  {
+    return halJournalRead(offset(slot), frame, sizeof(Frame));
+  }
+
+  bool sectorErased(uint32_t sector) const
+  {
+    for (uint32_t slot = sector * perSector_; slot < (sector + 1) * perSector_; slot++)
+    {
+      if (!erased(slot)) return false;
+    }
+    return true;
+  }
+
+  bool erased(uint32_t slot) const
+  {
+    Frame frame;
+    if (!readSlot(slot, &frame)) return false;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&frame);
+    for (size_t i = 0; i < sizeof(Frame); i++)
+    {
+      if (bytes[i] != 0xff) return false;
+    }
+    return true;
+  }
+
+  static bool valid(const Frame& frame)
+  {
+    return frame.sequence != 0 and frame.sequence != 0xffffffff and frame.crc == crc16(&frame, offsetof(Frame, crc));
+  }
+
+  static uint16_t crc16(const void* data, size_t size)
+  { // CRC-16/CCITT-FALSE
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    uint16_t crc = 0xffff;
+    for (size_t i = 0; i < size; i++)
+    {
+      crc ^= uint16_t(bytes[i]) << 8;
+      for (int bit = 0; bit < 8; bit++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+  }
+
+  uint32_t sectorSize_ = 0;
+  uint32_t perSector_ = 0; // rekordów w sektorze
+  uint32_t slots_ = 0; // rekordów w całym obszarze
+  uint32_t sequence_ = 0; // numer najnowszego rekordu
+  uint32_t next_ = 0; // miejsce następnego zapisu
+  uint32_t ready_ = 0; // sektory skasowane z wyprzedzeniem, począwszy od enterSector()
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <Arduino.h>
+
+// warstwa abstrakcji sprzętu
+// ESP32: MCP23017, PWM, WiFi, HTTPClient, PubSubClient i DS18B20 (src/hal_esp32.cpp)
+// native: symulowana płytka z modelami rolet, API i brokerem MQTT (src/hal_native.cpp)
+
+// MCP23017 - do 8 układów na magistrali, chip = numer układu 0..7 (adres 0x20 + chip)
+bool halMcpBegin(uint8_t chip);
+void halMcpPinMode(uint8_t chip, uint8_t pin, uint8_t mode);
+uint8_t halMcpDigitalRead(uint8_t chip, uint8_t pin);
+void halMcpDigitalWrite(uint8_t chip, uint8_t pin, uint8_t value);
+uint16_t halMcpReadGPIOAB(uint8_t chip); // port A na bitach 0-7, port B na bitach 8-15
+void halMcpWriteGPIOAB(uint8_t chip, uint16_t value);
+uint32_t halMcpTransactions(); // licznik transakcji I2C od uruchomienia
+void halMcpSetupInterrupts(uint8_t chip, uint16_t pins, void (*isr)()); // przerwanie przy zmianie stanu pinów z maski, kasowane odczytem GPIOAB
+// wyjścia przerwań wszystkich układów na wspólnej linii (open-drain)
+
+// sterowanie prędkością silników na pinach ESP - PWM LEDC, osobny kanał dla każdego pinu (do 16)
+void halSpeedBegin(uint32_t frequency, uint8_t resolution); // wspólne dla wszystkich kanałów, przed halSpeedPinInit
+bool halSpeedPinValid(int pin); // pin ESP z wyjściem, wolny od magistral płytki (I2C, 1-Wire, przerwanie MCP, UART, flash)
+bool halSpeedPinInit(uint8_t pin); // false bez wolnego kanału LEDC lub przy błędzie konfiguracji - pin w stanie niskim, silnik stoi
+void halSpeedWrite(uint8_t pin, float duty); // wypełnienie 0..1 (w rozdzielczości PWM), 0 = silnik zatrzymany
+
+// WiFi
+void halWiFiBegin(const String& hostname, const char* ssid, const char* password);
+bool halWiFiConnected();
+int halWiFiStatus();
+String halWiFiIP();
+String halWiFiSSID();
+String halWiFiMac();
+long halWiFiRSSI();
+
+// HTTP - zwraca kod odpowiedzi (<= 0 przy błędzie połączenia), token pusty = bez nagłówka Authorization
+// wszystkie zadania korzystają z jednego połączenia keep-alive do API, żądania czekają w kolejce na blokadzie
+int halHttpRequest(const char* method, const char* url, const char* payload, const String& token, String* response);
+uint32_t halHttpConnections(); // liczba połączeń TCP otwartych do API od uruchomienia
+
+// MQTT
+typedef void (*HalMqttCallback)(char*, byte*, unsigned int);
+void halMqttSetup(const char* server, int port, HalMqttCallback callback, int bufferSize);
+bool halMqttConnect(const char* id, const char* user, const char* password, const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage);
+bool halMqttConnected();
+int halMqttState();
+bool halMqttSubscribe(const char* topic);
+bool halMqttPublish(const char* topic, const char* payload, bool retained); // wiadomość dłuższa niż bufor klienta wysyłana strumieniowo
+void halMqttLoop();
+bool halMqttWait(uint32_t timeoutMs); // oczekiwanie na dane z brokera (gotowość gniazda), true = są dane do halMqttLoop
+// wywołania MQTT są bezpieczne z wielu zadań (wspólna blokada klienta), callback wykonuje się w zadaniu wołającym halMqttLoop
+
+// pamięć nieulotna (NVS) - liczby i teksty pod kluczami do 15 znaków
+void halNvsBegin();
+bool halNvsGetInt(const char* key, int32_t* value); // false, gdy klucza nie ma
+void halNvsSetInt(const char* key, int32_t value);
+bool halNvsGetString(const char* key, char* value, size_t size); // false, gdy klucza nie ma lub tekst nie mieści się w buforze
+void halNvsSetString(const char* key, const char* value);
+void halNvsRemove(const char* key);
+
+// dziennik we flash - obszar podzielony na sektory kasowane w całości (kasowanie ustawia bajty na 0xFF),
+// zapis tylko zeruje bity, więc rekord dopisuje się wyłącznie do skasowanych komórek
+uint32_t halJournalBegin(); // rozmiar obszaru w bajtach, 0 = brak obszaru
+uint32_t halJournalSectorSize();
+bool halJournalRead(uint32_t offset, void* data, size_t size);
+bool halJournalWrite(uint32_t offset, const void* data, size_t size);
+bool halJournalErase(uint32_t sector); // trwa kilkadziesiąt ms
+
+// sterta - wolna pamięć i największy ciągły wolny blok (spadek przy stałej wolnej pamięci = fragmentacja)
+uint32_t halHeapFree();
+uint32_t halHeapLargestFreeBlock();
+
+// obciążenie rdzeni - próbkowanie zadania wykonywanego w chwili ticka FreeRTOS
+void halCpuLoadBegin();
+float halCpuLoad(uint8_t core); // % ticków rdzenia poza zadaniem idle od poprzedniego wywołania dla tego rdzenia
+
+// DS18B20 - pomiar bez blokowania: halTempRequest() startuje konwersję na wszystkich czujnikach magistrali,
+// wyniki odczytywane halTempC() po halTempReady() (750 ms przy 12 bitach)
+uint8_t halTempBegin(uint8_t resolution); // rozdzielczość 9..12 bitów, zwraca liczbę czujników
+void halTempRequest();
+bool halTempReady();
+float halTempC(uint8_t index); // wynik ostatniej konwersji, -127 = brak czujnika (DEVICE_DISCONNECTED_C)
+
+#endif
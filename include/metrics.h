@@ -0,0 +1,109 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+// metryki czasu działania urządzenia - histogramy czasów w us bez blokad i bez sterty
+// zapisy z dowolnych zadań (liczniki atomowe), odczyt w trakcie zapisów daje przybliżony, ale spójny obraz
+
+class Histogram
+{ // przedziały potęg dwójki: [0, 64 us), [64, 128 us) ... [0.52 s, 1.05 s), ostatni - powyżej 1.05 s
+public:
+  static const int Buckets = 16;
+
+  void record(int64_t us)
+  {
+    uint32_t value = us < 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : uint32_t(us);
+    int bucket = 0;
+    while (bucket < Buckets - 1 and value >= edge(bucket)) bucket++;
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+    uint32_t max = max_.load(std::memory_order_relaxed);
+    while (value > max and !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+  }
+
+  uint32_t count() const
+  {
+    uint32_t total = 0;
+    for (int i = 0; i < Buckets; i++) total += counts_[i].load(std::memory_order_relaxed);
+    return total;
+  }
+
+  uint32_t percentile(int percent) const
+  { // górna granica przedziału z zadanym percentylem, nie większa od maksimum
+    uint32_t total = count();
+    uint32_t max = max_.load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+    uint64_t wanted = (uint64_t(total) * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < Buckets - 1; i++)
+    {
+      seen += counts_[i].load(std::memory_order_relaxed);
+      if (seen >= wanted) return edge(i) < max ? edge(i) : max;
+    }
+    return max;
+  }
+
+  int format(char* out, size_t size) const
+  { // {"n":..,"p50":..,"p99":..,"max":..,"h":[...]} - liczności przedziałów bez końcowych zer
+    int last = Buckets - 1;
+    while (last > 0 and counts_[last].load(std::memory_order_relaxed) == 0) last--;
+    int length = snprintf(out, size, "{\"n\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u,\"h\":[",
+      (unsigned)count(), (unsigned)percentile(50), (unsigned)percentile(99), (unsigned)max_.load(std::memory_order_relaxed));
+    for (int i = 0; i <= last and length < (int)size; i++)
+    {
+      length += snprintf(out + length, size - length, "%s%u", i ? "," : "", (unsigned)counts_[i].load(std::memory_order_relaxed));
+    }
+    if (length < (int)size) length += snprintf(out + length, size - length, "]}");
+    return length;
+  }
+
+private:
+  static uint32_t edge(int bucket)
+  {
+    return 64u << bucket;
+  }
+
+  std::atomic<uint32_t> counts_[Buckets] = {};
+  std::atomic<uint32_t> max_{0};
+};
+
+class LoopMetrics
+{ // cykle pętli zadania: okres między startami, odchyłka startu od planowanej chwili i czas pracy cyklu
+  // begin/end/pause wywołuje tylko zadanie pętli
+public:
+  void begin(int64_t now, int64_t expected)
+  { // expected - planowany start cyklu (okres timera, wybudzenie), -1 = bez pomiaru odchyłki
+    if (last_ >= 0) period.record(now - last_);
+    if (expected >= 0) jitter.record(now > expected ? now - expected : expected - now);
+    last_ = now;
+    start_ = now;
+  }
+
+  void end(int64_t now)
+  {
+    busy.record(now - start_);
+  }
+
+  void pause()
+  { // pętla wstrzymana (np. timer zatrzymany) - kolejny cykl bez pomiaru okresu
+    last_ = -1;
+  }
+
+  int64_t lastStart() const
+  {
+    return last_;
+  }
+
+  Histogram period;
+  Histogram jitter;
+  Histogram busy;
+
+private:
+  int64_t last_ = -1;
+  int64_t start_ = 0;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <stdint.h>
+
+// seqlock - jeden pisarz, wielu czytelników bez blokad
+// pisarz nigdy nie czeka, czytelnik powtarza kopię, jeżeli w jej trakcie trwał zapis
+// T musi być trywialnie kopiowalne (bez String), pisarz powinien mieć wyższy priorytet niż czytelnicy
+// czytelnik o wyższym priorytecie na rdzeniu pisarza nie może czekać w read() - używa tryRead()
+
+template <typename T>
+class SeqLock
+{
+public:
+  void write(const T& value)
+  {
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed); // nieparzysta wartość = zapis w toku
+    std::atomic_thread_fence(std::memory_order_release);
+    value_ = value;
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  T read() const
+  {
+    T value;
+    uint32_t before;
+    uint32_t after;
+    do
+    {
+      before = sequence_.load(std::memory_order_acquire);
+      value = value_;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence_.load(std::memory_order_relaxed);
+    } while ((before & 1) or before != after);
+    return value;
+  }
+
+  bool tryRead(T& value) const
+  { // jedna próba bez czekania - false, gdy zapis był w toku (value bez zmian)
+    uint32_t before = sequence_.load(std::memory_order_acquire);
+    if (before & 1) return false;
+    T copy = value_;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) != before) return false;
+    value = copy;
+    return true;
+  }
+
+private:
+  std::atomic<uint32_t> sequence_{0};
+  T value_{};
+};
+
+#endif
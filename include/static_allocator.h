@@ -0,0 +1,68 @@
+#ifndef STATIC_ALLOCATOR_H
+#define STATIC_ALLOCATOR_H
+
+#include <ArduinoJson.h>
+#include <string.h>
+
+// alokator ArduinoJson na stałym buforze - dokument nie korzysta ze sterty
+// bloki przydzielane kolejno, pamięć odzyskiwana przez reset() przed następnym dokumentem
+// (dokument używający alokatora musi być wtedy już zniszczony)
+
+template <size_t Size>
+class StaticAllocator : public ArduinoJson::Allocator
+{
+public:
+  void* allocate(size_t size) override
+  {
+    size_t needed = sizeof(Header) + align(size);
+    if (used_ + needed > Size) return nullptr; // ArduinoJson zgłosi NoMemory
+    Header* header = reinterpret_cast<Header*>(buffer_ + used_);
+    header->size = size;
+    last_ = used_;
+    used_ += needed;
+    return header + 1;
+  }
+
+  void deallocate(void* pointer) override
+  {
+    if (pointer != nullptr and offset(pointer) == last_) used_ = last_; // zwalniany jest tylko ostatni blok
+  }
+
+  void* reallocate(void* pointer, size_t size) override
+  { // ostatni blok (np. pula zmniejszana po parsowaniu) zmieniany w miejscu, pozostałe kopiowane
+    if (pointer == nullptr) return allocate(size);
+    Header* header = static_cast<Header*>(pointer) - 1;
+    if (offset(pointer) == last_ and last_ + sizeof(Header) + align(size) <= Size)
+    {
+      header->size = size;
+      used_ = last_ + sizeof(Header) + align(size);
+      return pointer;
+    }
+    void* moved = allocate(size);
+    if (moved != nullptr) memcpy(moved, pointer, header->size < size ? header->size : size);
+    return moved;
+  }
+
+  void reset()
+  {
+    used_ = 0;
+    last_ = Size;
+  }
+
+  size_t used() const { return used_; }
+
+private:
+  struct Header
+  {
+    size_t size;
+  } __attribute__((aligned(8)));
+
+  static size_t align(size_t size) { return (size + 7) & ~size_t(7); }
+  size_t offset(void* pointer) const { return reinterpret_cast<uint8_t*>(static_cast<Header*>(pointer) - 1) - buffer_; }
+
+  alignas(8) uint8_t buffer_[Size];
+  size_t used_ = 0;
+  size_t last_ = Size;
+};
+
+#endif
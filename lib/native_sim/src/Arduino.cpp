@@ -0,0 +1,100 @@
+#include "Arduino.h"
+
+#include <stdarg.h>
+
+#include "sim.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  simGpioWrite(pin, val ? 255 : 0);
+}
+
+int digitalRead(uint8_t pin)
+{
+  return simGpioRead(pin) > 0 ? HIGH : LOW;
+}
+
+unsigned long millis()
+{
+  return simMicros() / 1000;
+}
+
+unsigned long micros()
+{
+  return esp_timer_get_time();
+}
+
+void delay(uint32_t ms)
+{
+  simSleepUs(ms * 1000LL);
+}
+
+int64_t esp_timer_get_time()
+{
+  return simMicros();
+}
+
+float temperatureRead()
+{
+  return simChipTemperature();
+}
+
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* server1, const char* server2, const char* server3)
+{ // zegar hosta jest już zsynchronizowany
+}
+
+bool getLocalTime(struct tm* info, uint32_t ms)
+{
+  time_t now = time(NULL);
+  localtime_r(&now, info);
+  return true;
+}
+
+size_t HardwareSerial::print(const String& s)
+{
+  if (!simSerialEnabled()) return s.length();
+  return fwrite(s.c_str(), 1, s.length(), stdout);
+}
+
+size_t HardwareSerial::print(const char* s)
+{
+  if (!simSerialEnabled()) return strlen(s);
+  return fputs(s, stdout) < 0 ? 0 : strlen(s);
+}
+
+size_t HardwareSerial::print(char c)
+{
+  if (!simSerialEnabled()) return 1;
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::println()
+{
+  if (!simSerialEnabled()) return 1;
+  fputc('\n', stdout);
+  fflush(stdout);
+  return 1;
+}
+
+size_t HardwareSerial::printf(const char* format, ...)
+{
+  if (!simSerialEnabled()) return 0;
+  va_list args;
+  va_start(args, format);
+  int n = vprintf(format, args);
+  va_end(args);
+  fflush(stdout);
+  return n < 0 ? 0 : n;
+}
+
+void EspClass::restart()
+{
+  simRestart();
+}
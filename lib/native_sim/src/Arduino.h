@@ -0,0 +1,85 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// zastępczy rdzeń Arduino-ESP32 dla środowiska [env:native]
+// dostarcza tylko to, czego używa kod w src/ - peryferia płytki są w hal.h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+
+#include "WString.h"
+#include "sim_freertos.h"
+#include "sim_esp_timer.h"
+
+using std::abs;
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define IRAM_ATTR
+#define CONFIG_ARDUINO_LOOP_STACK_SIZE 8192 // stos loopTask (setup i loop) w sdkconfig Arduino-ESP32
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+
+float temperatureRead();
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* server1, const char* server2 = NULL, const char* server3 = NULL);
+bool getLocalTime(struct tm* info, uint32_t ms = 5000);
+
+class HardwareSerial
+{
+public:
+  void begin(unsigned long baud) {}
+  size_t print(const String& s);
+  size_t print(const char* s);
+  size_t print(char c);
+  size_t print(int n) { return print(String(n)); }
+  size_t print(unsigned int n) { return print(String(n)); }
+  size_t print(long n) { return print(String(n)); }
+  size_t print(unsigned long n) { return print(String(n)); }
+  size_t print(long long n) { return print(String(n)); }
+  size_t print(unsigned long long n) { return print(String(n)); }
+  size_t print(double n, int digits = 2) { return print(String(n, digits)); }
+  size_t println();
+  template <typename T> size_t println(const T& value) { size_t n = print(value); return n + println(); }
+  size_t println(double n, int digits) { size_t r = print(n, digits); return r + println(); }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern HardwareSerial Serial;
+
+class EspClass
+{
+public:
+  const char* getChipModel() { return "Simulated ESP32"; }
+  uint8_t getChipCores() { return 2; }
+  uint32_t getCpuFreqMHz() { return 240; }
+  void restart();
+};
+
+extern EspClass ESP;
+
+void setup();
+void loop();
+
+#endif
@@ -0,0 +1,120 @@
+#include "WString.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+static std::string toBase(unsigned long long value, bool negative, unsigned char base)
+{
+  if (base < 2 || base > 36) base = 10;
+  char buf[72];
+  int i = sizeof(buf) - 1;
+  buf[i] = 0;
+  do
+  {
+    int digit = value % base;
+    buf[--i] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value && i > 1);
+  if (negative) buf[--i] = '-';
+  return std::string(&buf[i]);
+}
+
+static std::string toDecimal(double value, unsigned int decimalPlaces)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  return std::string(buf);
+}
+
+String::String(unsigned char value, unsigned char base) : str_(toBase(value, false, base)) {}
+String::String(int value, unsigned char base) : str_(base == 10 && value < 0 ? toBase(-(long long)value, true, base) : toBase((unsigned int)value, false, base)) {}
+String::String(unsigned int value, unsigned char base) : str_(toBase(value, false, base)) {}
+String::String(long value, unsigned char base) : str_(base == 10 && value < 0 ? toBase(-(long long)value, true, base) : toBase((unsigned long)value, false, base)) {}
+String::String(unsigned long value, unsigned char base) : str_(toBase(value, false, base)) {}
+String::String(long long value, unsigned char base) : str_(base == 10 && value < 0 ? toBase(-(unsigned long long)value, true, base) : toBase((unsigned long long)value, false, base)) {}
+String::String(unsigned long long value, unsigned char base) : str_(toBase(value, false, base)) {}
+String::String(float value, unsigned int decimalPlaces) : str_(toDecimal(value, decimalPlaces)) {}
+String::String(double value, unsigned int decimalPlaces) : str_(toDecimal(value, decimalPlaces)) {}
+
+bool String::endsWith(const String& suffix) const
+{
+  if (suffix.str_.length() > str_.length()) return false;
+  return str_.compare(str_.length() - suffix.str_.length(), suffix.str_.length(), suffix.str_) == 0;
+}
+
+void String::toCharArray(char* buf, unsigned int bufsize, unsigned int index) const
+{
+  if (!bufsize || !buf) return;
+  if (index >= str_.length())
+  {
+    buf[0] = 0;
+    return;
+  }
+  unsigned int n = str_.length() - index;
+  if (n > bufsize - 1) n = bufsize - 1;
+  memcpy(buf, str_.c_str() + index, n);
+  buf[n] = 0;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const
+{
+  size_t pos = str_.find(ch, fromIndex);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String& s, unsigned int fromIndex) const
+{
+  size_t pos = str_.find(s.str_, fromIndex);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int beginIndex) const
+{
+  return beginIndex < str_.length() ? String(str_.substr(beginIndex)) : String();
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const
+{
+  if (beginIndex > endIndex)
+  {
+    unsigned int temp = endIndex;
+    endIndex = beginIndex;
+    beginIndex = temp;
+  }
+  if (beginIndex >= str_.length()) return String();
+  return String(str_.substr(beginIndex, endIndex - beginIndex));
+}
+
+void String::trim()
+{
+  size_t begin = 0;
+  while (begin < str_.length() && isspace((unsigned char)str_[begin])) begin++;
+  size_t end = str_.length();
+  while (end > begin && isspace((unsigned char)str_[end - 1])) end--;
+  str_ = str_.substr(begin, end - begin);
+}
+
+long String::toInt() const
+{
+  return atol(str_.c_str());
+}
+
+float String::toFloat() const
+{
+  return atof(str_.c_str());
+}
+
+StringSumHelper operator+(const String& lhs, const String& rhs) { StringSumHelper s(lhs); s.concat(rhs); return s; }
+StringSumHelper operator+(const String& lhs, const char* rhs) { StringSumHelper s(lhs); s.concat(rhs); return s; }
+StringSumHelper operator+(const char* lhs, const String& rhs) { StringSumHelper s(lhs); s.concat(rhs); return s; }
+StringSumHelper operator+(const String& lhs, char rhs) { StringSumHelper s(lhs); s.concat(rhs); return s; }
+StringSumHelper operator+(const String& lhs, unsigned char rhs) { return lhs + String(rhs); }
+StringSumHelper operator+(const String& lhs, int rhs) { return lhs + String(rhs); }
+StringSumHelper operator+(const String& lhs, unsigned int rhs) { return lhs + String(rhs); }
+StringSumHelper operator+(const String& lhs, long rhs) { return lhs + String(rhs); }
+StringSumHelper operator+(const String& lhs, unsigned long rhs) { return lhs + String(rhs); }
+StringSumHelper operator+(const String& lhs, long long rhs) { return lhs + String(rhs); }
+StringSumHelper operator+(const String& lhs, unsigned long long rhs) { return lhs + String(rhs); }
+StringSumHelper operator+(const String& lhs, float rhs) { return lhs + String(rhs); }
+StringSumHelper operator+(const String& lhs, double rhs) { return lhs + String(rhs); }
@@ -0,0 +1,97 @@
+#ifndef WSTRING_H
+#define WSTRING_H
+
+#include <string>
+#include <cstring>
+
+// minimalna wersja Arduino String na potrzeby kompilacji na hoście
+// (interfejs zgodny z używanym w src/ oraz przez ArduinoJson)
+
+class StringSumHelper;
+
+class String
+{
+public:
+  String() {}
+  String(const char* cstr) : str_(cstr ? cstr : "") {}
+  String(const char* cstr, unsigned int length) : str_(cstr ? std::string(cstr, length) : "") {}
+  String(const std::string& str) : str_(str) {}
+  explicit String(char c) : str_(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimalPlaces = 2);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+
+  unsigned int length() const { return str_.length(); }
+  bool isEmpty() const { return str_.empty(); }
+  const char* c_str() const { return str_.c_str(); }
+  bool reserve(unsigned int size) { str_.reserve(size); return true; }
+
+  bool concat(const String& s) { str_ += s.str_; return true; }
+  bool concat(const char* cstr) { if (cstr) str_ += cstr; return true; }
+  bool concat(const char* cstr, unsigned int length) { if (cstr) str_.append(cstr, length); return true; }
+  bool concat(char c) { str_ += c; return true; }
+
+  String& operator+=(const String& rhs) { concat(rhs); return *this; }
+  String& operator+=(const char* rhs) { concat(rhs); return *this; }
+  String& operator+=(char rhs) { concat(rhs); return *this; }
+  String& operator+=(int rhs) { concat(String(rhs)); return *this; }
+  String& operator+=(unsigned int rhs) { concat(String(rhs)); return *this; }
+  String& operator+=(long rhs) { concat(String(rhs)); return *this; }
+  String& operator+=(unsigned long rhs) { concat(String(rhs)); return *this; }
+  String& operator+=(float rhs) { concat(String(rhs)); return *this; }
+  String& operator+=(double rhs) { concat(String(rhs)); return *this; }
+
+  bool equals(const String& s) const { return str_ == s.str_; }
+  bool equals(const char* cstr) const { return str_ == (cstr ? cstr : ""); }
+  bool operator==(const String& rhs) const { return equals(rhs); }
+  bool operator==(const char* rhs) const { return equals(rhs); }
+  bool operator!=(const String& rhs) const { return !equals(rhs); }
+  bool operator!=(const char* rhs) const { return !equals(rhs); }
+  bool operator<(const String& rhs) const { return str_ < rhs.str_; }
+  bool startsWith(const String& prefix) const { return str_.compare(0, prefix.str_.length(), prefix.str_) == 0; }
+  bool endsWith(const String& suffix) const;
+
+  char charAt(unsigned int index) const { return index < str_.length() ? str_[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char& operator[](unsigned int index) { return str_[index]; }
+  void toCharArray(char* buf, unsigned int bufsize, unsigned int index = 0) const;
+  int indexOf(char ch, unsigned int fromIndex = 0) const;
+  int indexOf(const String& s, unsigned int fromIndex = 0) const;
+  String substring(unsigned int beginIndex) const;
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+  void trim();
+  long toInt() const;
+  float toFloat() const;
+
+private:
+  std::string str_;
+};
+
+class StringSumHelper : public String
+{
+public:
+  StringSumHelper(const String& s) : String(s) {}
+  StringSumHelper(const char* p) : String(p) {}
+};
+
+StringSumHelper operator+(const String& lhs, const String& rhs);
+StringSumHelper operator+(const String& lhs, const char* rhs);
+StringSumHelper operator+(const char* lhs, const String& rhs);
+StringSumHelper operator+(const String& lhs, char rhs);
+StringSumHelper operator+(const String& lhs, unsigned char rhs);
+StringSumHelper operator+(const String& lhs, int rhs);
+StringSumHelper operator+(const String& lhs, unsigned int rhs);
+StringSumHelper operator+(const String& lhs, long rhs);
+StringSumHelper operator+(const String& lhs, unsigned long rhs);
+StringSumHelper operator+(const String& lhs, long long rhs);
+StringSumHelper operator+(const String& lhs, unsigned long long rhs);
+StringSumHelper operator+(const String& lhs, float rhs);
+StringSumHelper operator+(const String& lhs, double rhs);
+
+#endif
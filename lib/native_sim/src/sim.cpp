@@ -0,0 +1,1050 @@
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sched.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// okablowanie symulowanej płytki - odpowiada domyślnemu okablowaniu płytki produkcyjnej (src/main.cpp)
+static const SimBlindSpec Sim_Board[] = {
+  // id, chip, up, down, sensorUp, sensorDown, speed, runtimeUp, runtimeDown, passUp, passDown, position
+  {3, 0, 12, 13, 0, 1, 26, 8000, 7000, 300, 300, 0},
+  {4, 0, 15, 14, 2, 3, 25, 8200, 7100, 300, 300, 0},
+  {5, 0, 10, 11, 5, 4, 33, 7800, 6900, 300, 300, 0},
+  {6, 0,  9,  8, 6, 7, 32, 8100, 7050, 300, 300, 0},
+};
+static const int Sim_Board_Count = sizeof(Sim_Board) / sizeof(Sim_Board[0]);
+static const int Sim_Blinds_Max = 32; // 8 układów MCP23017 po 4 rolety
+static const int Sim_Mcp_Max = 8;
+static const uint8_t Sim_No_Speed_Pin = 0xff; // silnik bez sterowania prędkością - pełna prędkość przy załączonym przekaźniku
+static const float Sim_Motor_Curve[][2] = { // prędkość silnika (ułamek pełnej) przy wypełnieniu PWM w % - martwa strefa i nieliniowość
+  {0, 0}, {20, 0}, {50, 0.4}, {70, 0.62}, {100, 1},
+};
+static const char* Sim_Speed_Table = "[[20,0],[50,40],[70,62]]"; // ta sama krzywa w kalibracji rolet z API
+static const float Sim_Overtravel_Limit = 0.05; // mechaniczny zakres za krańcówką (ułamek przejazdu)
+static const int Sim_Http_Latency_Ms = 20;
+static const int Sim_Http_Connect_Ms = 120; // DNS, TCP i pierwsze okno po WiFi
+static const int Sim_Http_Idle_Timeout_Ms = 5000; // serwer zamyka bezczynne połączenie keep-alive
+static const int Sim_I2c_Byte_Us = 90; // 9 bitów na bajt przy 100 kHz
+static const int Sim_WiFi_Connect_Ms = 300; // skojarzenie z punktem dostępowym i DHCP
+static const uint32_t Sim_Journal_Size = 65536; // obszar dziennika we flash
+static const uint32_t Sim_Journal_Sector_Size = 4096;
+static const int Sim_Flash_Erase_Ms = 45; // kasowanie sektora 4 KB
+
+struct SimBlindState
+{
+  float travel;    // 0.0 = góra, 1.0 = dół
+  bool moving;
+  int64_t startedUs; // ostatni start silnika (zegar urządzenia)
+  int64_t endstopUs; // zadziałanie krańcówki w trakcie jazdy, -1 = brak od startu silnika
+  int64_t endstopStopUs; // od krańcówki do zatrzymania silnika przy ostatnim zatrzymaniu, -1 = zatrzymanie przed krańcówką
+  bool sensorUp;
+  bool sensorDown;
+};
+
+struct SimApiBlind
+{
+  int position;
+  int runtimeUp;
+  int runtimeDown;
+};
+
+static std::mutex Sim_Lock;
+static bool Sim_Verbose = false;
+static bool Sim_Pinning = true; // zadania przypięte do rdzenia na procesorze hosta, --no-pin = porównanie bez przypięcia
+static long Sim_Duration_Ms = 0;
+static const char* Sim_Bench = NULL;
+static double Sim_Speed = 1; // mnożnik zegara urządzenia
+static int Sim_Speed_Ramp_Ms = 0; // "speed_ramp" w konfiguracji API (--ramp ms)
+static float Sim_Runtime_Error = 0; // błąd czasów przejazdu zapisanych w API względem rzeczywistych w % (--runtime-error %)
+static unsigned Sim_Seed = 1; // ziarno rand() - powtarzalne przebiegi benchmarków z losowymi scenariuszami (--seed N)
+static const auto Sim_Start = std::chrono::steady_clock::now();
+
+struct SimMcp
+{
+  uint16_t iodir;
+  uint16_t olat;
+  uint16_t input;
+  uint16_t gpinten;
+  bool intActive; // wyjście INT układu trzyma wspólną linię w stanie niskim
+};
+
+static float Gpio_Duty[40] = {}; // wypełnienie 0..1
+static std::vector<SimBlindSpec> Sim_Blinds; // z --blinds N kolejne rolety na kolejnych układach MCP
+static int Sim_Mcp_Count = 1;
+static SimMcp Mcp[Sim_Mcp_Max];
+static void (*Mcp_Isr)() = NULL; // wspólna linia przerwań wszystkich układów (open-drain)
+static std::atomic<uint64_t> I2c_Bytes{0};
+static std::vector<SimBlindState> Blind_State;
+static int64_t WiFi_Begin_Us = -1;
+static bool Http_Connection_Open = false;
+static long Http_Last_Request_Ms = 0;
+static SimHttpStats Http_Stats = {};
+static bool Api_Available = true;
+static std::map<std::string, std::string> Nvs_Values; // liczby zapisane tekstowo
+static const char* Sim_Nvs_File = NULL;
+static uint32_t Nvs_Writes = 0;
+static std::vector<uint8_t> Journal_Flash(Sim_Journal_Size, 0xff);
+static uint32_t Journal_Next = 0; // koniec ostatniego zapisu - tu trafia zapis przerwany utratą zasilania
+static uint32_t Journal_Erases_Moving = 0;
+static const int Sim_Temp_Count = 2; // czujniki DS18B20 na magistrali OneWire
+static int Temp_Resolution = 12;
+static int64_t Temp_Requested_Us = -1; // start ostatniej konwersji
+static bool Temp_Has_Value = false; // rejestr czujnika zawiera wynik wcześniejszej konwersji
+
+static std::vector<SimApiBlind> Api_Blinds;
+static const char* Api_Access_Token = "sim-access";
+static const char* Api_Refresh_Token = "sim-refresh";
+
+static std::mutex Mqtt_Lock;
+static bool Mqtt_Connected = false;
+static int Mqtt_Buffer_Size = 256;
+static std::vector<std::string> Mqtt_Subscriptions;
+static std::map<std::string, std::string> Mqtt_Retained;
+static std::map<std::string, std::string> Mqtt_Published;
+static std::map<std::string, uint32_t> Mqtt_Published_Count;
+static std::deque<std::pair<std::string, std::string>> Mqtt_Inbox;
+static std::condition_variable Mqtt_Arrived; // nowa wiadomość w Mqtt_Inbox
+static SimMqttStats Mqtt_Stats = {};
+
+
+static bool mcpPinHigh(uint16_t reg, uint8_t pin)
+{
+  return reg & (1 << pin);
+}
+
+static void i2cTransfer(int bytes)
+{ // czas zajętości magistrali I2C (adres, rejestr i dane)
+  I2c_Bytes += bytes;
+  simSleepUs(bytes * Sim_I2c_Byte_Us);
+}
+
+static bool interruptLine()
+{ // wspólna linia INT - aktywna, gdy którykolwiek układ zgłasza przerwanie
+  for (int chip = 0; chip < Sim_Mcp_Count; chip++)
+  {
+    if (Mcp[chip].intActive) return true;
+  }
+  return false;
+}
+
+static void updateInputs()
+{ // odwzorowanie stanu krańcówek na wejściach MCP (krańcówka wciśnięta = HIGH)
+  uint16_t previous[Sim_Mcp_Max];
+  for (int chip = 0; chip < Sim_Mcp_Count; chip++) previous[chip] = Mcp[chip].input;
+  for (size_t i = 0; i < Sim_Blinds.size(); i++)
+  {
+    const SimBlindSpec& spec = Sim_Blinds[i];
+    SimMcp& mcp = Mcp[spec.chip];
+    mcp.input &= ~((1 << spec.sensorUpPin) | (1 << spec.sensorDownPin));
+    if (Blind_State[i].sensorUp) mcp.input |= 1 << spec.sensorUpPin;
+    if (Blind_State[i].sensorDown) mcp.input |= 1 << spec.sensorDownPin;
+  }
+
+  // interrupt-on-change: INT układu aktywne do odczytu GPIO, zbocze na wspólnej linii tylko gdy była nieaktywna
+  bool line = interruptLine();
+  bool raised = false;
+  for (int chip = 0; chip < Sim_Mcp_Count; chip++)
+  {
+    SimMcp& mcp = Mcp[chip];
+    if (((previous[chip] ^ mcp.input) & mcp.gpinten) and !mcp.intActive)
+    {
+      mcp.intActive = true;
+      raised = true;
+    }
+  }
+  if (raised and !line and Mcp_Isr) Mcp_Isr();
+}
+
+static void worldSave()
+{ // z --nvs położenie rolet zapisywane obok NVS - kolejne uruchomienie zastaje rolety tam, gdzie stanęły
+  if (Sim_Nvs_File == NULL) return;
+  std::ofstream file(std::string(Sim_Nvs_File) + ".blinds", std::ios::trunc);
+  for (size_t i = 0; i < Sim_Blinds.size(); i++) file << Blind_State[i].travel << "\n";
+}
+
+static float motorSpeed(float duty)
+{ // interpolacja Sim_Motor_Curve
+  float percent = duty * 100;
+  for (size_t i = 1; i < sizeof(Sim_Motor_Curve) / sizeof(Sim_Motor_Curve[0]); i++)
+  {
+    const float* low = Sim_Motor_Curve[i - 1];
+    const float* high = Sim_Motor_Curve[i];
+    if (percent <= high[0]) return low[1] + (percent - low[0]) * (high[1] - low[1]) / (high[0] - low[0]);
+  }
+  return 1;
+}
+
+static void stepBlinds(float dtMs)
+{ // fizyka rolet: przekaźnik (wyjście MCP w stanie HIGH) i niezerowe PWM poruszają silnik
+  for (size_t i = 0; i < Sim_Blinds.size(); i++)
+  {
+    const SimBlindSpec& spec = Sim_Blinds[i];
+    SimBlindState& state = Blind_State[i];
+    const SimMcp& mcp = Mcp[spec.chip];
+    bool up = !mcpPinHigh(mcp.iodir, spec.upPin) and mcpPinHigh(mcp.olat, spec.upPin);
+    bool down = !mcpPinHigh(mcp.iodir, spec.downPin) and mcpPinHigh(mcp.olat, spec.downPin);
+    float speed = spec.speedPin == Sim_No_Speed_Pin ? 1 : motorSpeed(Gpio_Duty[spec.speedPin]);
+
+    bool moving = speed > 0 and up != down;
+    if (moving and up)
+    {
+      state.travel -= dtMs * speed / spec.runtimeUp;
+    }
+    else if (moving and down)
+    {
+      state.travel += dtMs * speed / spec.runtimeDown;
+    }
+    state.travel = std::max(-Sim_Overtravel_Limit, std::min(1 + Sim_Overtravel_Limit, state.travel));
+
+    bool sensorUp = state.travel <= 0;
+    bool sensorDown = state.travel >= 1;
+    if (Sim_Verbose)
+    {
+      if (moving != state.moving) printf("[sim] blind %d %s at %.2f%%\n", spec.id, moving ? "started" : "stopped", state.travel * 100);
+      if (sensorUp and !state.sensorUp) printf("[sim] blind %d upper limit switch\n", spec.id);
+      if (sensorDown and !state.sensorDown) printf("[sim] blind %d lower limit switch\n", spec.id);
+    }
+    int64_t now = simMicros();
+    if (moving and ((sensorUp and !state.sensorUp) or (sensorDown and !state.sensorDown))) state.endstopUs = now;
+    if (state.moving and !moving)
+    {
+      state.endstopStopUs = state.endstopUs >= 0 ? now - state.endstopUs : -1;
+      worldSave();
+    }
+    if (!state.moving and moving)
+    {
+      state.startedUs = now;
+      state.endstopUs = -1;
+    }
+    state.moving = moving;
+    state.sensorUp = sensorUp;
+    state.sensorDown = sensorDown;
+  }
+  updateInputs();
+}
+
+static void worldLoop()
+{ // krok symulacji co 1 ms zegara urządzenia
+  int64_t last = simMicros();
+  while (true)
+  {
+    simSleepUs(1000);
+    int64_t now = simMicros();
+    float dtMs = (now - last) / 1000.0;
+    last = now;
+    std::lock_guard<std::mutex> guard(Sim_Lock);
+    stepBlinds(dtMs);
+  }
+}
+
+static void stdinLoop()
+{ // wiadomości MQTT ze standardowego wejścia: "<topic> <payload>"
+  std::string line;
+  while (std::getline(std::cin, line))
+  {
+    if (line.empty() or line[0] == '#') continue;
+    size_t space = line.find(' ');
+    std::string topic = line.substr(0, space);
+    std::string payload = space == std::string::npos ? "" : line.substr(space + 1);
+    simMqttInject(topic.c_str(), payload.c_str());
+  }
+}
+
+void simBegin(int argc, char** argv)
+{
+  int blinds = Sim_Board_Count;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--verbose") == 0) Sim_Verbose = true;
+    else if (strcmp(argv[i], "--no-pin") == 0) Sim_Pinning = false;
+    else if (strcmp(argv[i], "--duration") == 0 and i + 1 < argc) Sim_Duration_Ms = atof(argv[++i]) * 1000;
+    else if (strcmp(argv[i], "--bench") == 0 and i + 1 < argc) Sim_Bench = argv[++i];
+    else if (strcmp(argv[i], "--nvs") == 0 and i + 1 < argc) Sim_Nvs_File = argv[++i];
+    else if (strcmp(argv[i], "--speed") == 0 and i + 1 < argc) Sim_Speed = std::max(1.0, atof(argv[++i]));
+    else if (strcmp(argv[i], "--ramp") == 0 and i + 1 < argc) Sim_Speed_Ramp_Ms = std::max(0, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--runtime-error") == 0 and i + 1 < argc) Sim_Runtime_Error = atof(argv[++i]);
+    else if (strcmp(argv[i], "--seed") == 0 and i + 1 < argc) Sim_Seed = strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "--blinds") == 0 and i + 1 < argc) blinds = std::max(1, std::min(Sim_Blinds_Max, atoi(argv[++i])));
+    else if (strcmp(argv[i], "--cpus") == 0 and i + 1 < argc)
+    { // ograniczenie procesu do N rdzeni (dziedziczone przez wszystkie wątki) - odpowiednik 2 rdzeni ESP32
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      for (int cpu = 0, n = atoi(argv[++i]); cpu < n; cpu++) CPU_SET(cpu, &cpus);
+      sched_setaffinity(0, sizeof(cpus), &cpus);
+    }
+  }
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  srand(Sim_Seed);
+
+  for (int i = 0; i < blinds; i++)
+  { // rolety ponad płytkę produkcyjną: układ i / 4 z okablowaniem rolety i % 4, bez sterowania prędkością
+    SimBlindSpec spec = Sim_Board[i % Sim_Board_Count];
+    if (i >= Sim_Board_Count)
+    {
+      spec.id = Sim_Board[0].id + i;
+      spec.chip = i / Sim_Board_Count;
+      spec.speedPin = Sim_No_Speed_Pin;
+    }
+    Sim_Blinds.push_back(spec);
+    Sim_Mcp_Count = std::max(Sim_Mcp_Count, spec.chip + 1);
+  }
+  Blind_State.resize(Sim_Blinds.size());
+  Api_Blinds.resize(Sim_Blinds.size());
+  for (int chip = 0; chip < Sim_Mcp_Max; chip++) Mcp[chip].iodir = 0xffff;
+
+  for (size_t i = 0; i < Sim_Blinds.size(); i++)
+  {
+    const SimBlindSpec& spec = Sim_Blinds[i];
+    Blind_State[i].travel = spec.position / 100.0;
+    Blind_State[i].sensorUp = Blind_State[i].travel <= 0;
+    Blind_State[i].sensorDown = Blind_State[i].travel >= 1;
+    Blind_State[i].endstopUs = -1;
+    Blind_State[i].endstopStopUs = -1;
+    Api_Blinds[i].position = spec.position;
+    Api_Blinds[i].runtimeUp = lroundf(spec.runtimeUp * (1 + Sim_Runtime_Error / 100));
+    Api_Blinds[i].runtimeDown = lroundf(spec.runtimeDown * (1 + Sim_Runtime_Error / 100));
+  }
+  updateInputs();
+
+  if (Sim_Nvs_File)
+  {
+    std::ifstream file(Sim_Nvs_File);
+    std::string key;
+    std::string value;
+    while (file >> key and std::getline(file >> std::ws, value)) Nvs_Values[key] = value;
+
+    std::ifstream blinds(std::string(Sim_Nvs_File) + ".blinds");
+    for (size_t i = 0; i < Sim_Blinds.size() and blinds >> Blind_State[i].travel; i++)
+    {
+      Blind_State[i].sensorUp = Blind_State[i].travel <= 0;
+      Blind_State[i].sensorDown = Blind_State[i].travel >= 1;
+    }
+    updateInputs();
+
+    std::ifstream journal(std::string(Sim_Nvs_File) + ".journal", std::ios::binary);
+    journal.read((char*)Journal_Flash.data(), Journal_Flash.size());
+    if (journal.gcount() != (std::streamsize)Journal_Flash.size()) std::fill(Journal_Flash.begin(), Journal_Flash.end(), 0xff);
+  }
+
+  std::thread(worldLoop).detach();
+  std::thread(stdinLoop).detach();
+}
+
+void simWait()
+{
+  if (Sim_Duration_Ms > 0)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(Sim_Duration_Ms));
+    return;
+  }
+  while (true) std::this_thread::sleep_for(std::chrono::hours(1));
+}
+
+const char* simBenchName()
+{
+  return Sim_Bench;
+}
+
+void simRestart()
+{
+  printf("[sim] ESP.restart()\n");
+  fflush(stdout);
+  _exit(1);
+}
+
+static void journalSave()
+{ // cały obraz flash przy każdym zapisie - 64 KB
+  if (Sim_Nvs_File == NULL) return;
+  std::ofstream file(std::string(Sim_Nvs_File) + ".journal", std::ios::binary | std::ios::trunc);
+  file.write((const char*)Journal_Flash.data(), Journal_Flash.size());
+}
+
+void simPowerCut(bool tornWrite)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  if (tornWrite and Journal_Next + 4 <= Sim_Journal_Size)
+  {
+    for (uint32_t i = Journal_Next; i < Journal_Next + 4; i++) Journal_Flash[i] &= rand();
+    journalSave();
+  }
+  worldSave();
+  printf("[sim] power cut%s\n", tornWrite ? " during flash write" : "");
+  fflush(stdout);
+  _exit(0);
+}
+
+double simSpeed()
+{
+  return Sim_Speed;
+}
+
+unsigned simSeed()
+{
+  return Sim_Seed;
+}
+
+int64_t simMicros()
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Sim_Start).count() * Sim_Speed;
+}
+
+int64_t simRealUs(int64_t us)
+{ // co najmniej 1 us, żeby krótkie oczekiwania przy dużym mnożniku nie zamieniały się w aktywne pętle
+  return us > 0 ? std::max<int64_t>(1, us / Sim_Speed) : 0;
+}
+
+void simSleepUs(int64_t us)
+{
+  std::this_thread::sleep_for(std::chrono::microseconds(simRealUs(us)));
+}
+
+bool simPinning()
+{
+  return Sim_Pinning;
+}
+
+bool simVerbose()
+{
+  return Sim_Verbose;
+}
+
+float simCpuLoad()
+{
+  static std::mutex lock;
+  static int64_t lastCpuUs = 0;
+  static int64_t lastWallUs = 0;
+  std::lock_guard<std::mutex> guard(lock);
+  struct timespec cpu;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+  int64_t cpuUs = cpu.tv_sec * 1000000LL + cpu.tv_nsec / 1000;
+  int64_t wallUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Sim_Start).count();
+  cpu_set_t cpus;
+  int cores = sched_getaffinity(0, sizeof(cpus), &cpus) == 0 ? CPU_COUNT(&cpus) : 1;
+  float load = wallUs > lastWallUs ? 100.0f * (cpuUs - lastCpuUs) / ((wallUs - lastWallUs) * cores) : 0;
+  lastCpuUs = cpuUs;
+  lastWallUs = wallUs;
+  return load;
+}
+
+bool simSerialEnabled()
+{
+  return Sim_Verbose or Sim_Bench == NULL;
+}
+
+float simChipTemperature()
+{
+  return 47.5;
+}
+
+void simGpioWrite(uint8_t pin, int duty)
+{
+  simPwmWrite(pin, std::max(0, std::min(255, duty)) / 255.0f);
+}
+
+int simGpioRead(uint8_t pin)
+{
+  if (pin >= sizeof(Gpio_Duty) / sizeof(Gpio_Duty[0])) return 0;
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  return lroundf(Gpio_Duty[pin] * 255);
+}
+
+void simPwmWrite(uint8_t pin, float duty)
+{
+  if (pin >= sizeof(Gpio_Duty) / sizeof(Gpio_Duty[0])) return;
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  Gpio_Duty[pin] = std::max(0.0f, std::min(1.0f, duty));
+}
+
+bool simMcpBegin(uint8_t chip)
+{ // układ bez potwierdzenia adresu na magistrali - begin_I2C zwraca false
+  i2cTransfer(1);
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  if (chip >= Sim_Mcp_Count) return false;
+  Mcp[chip].iodir = 0xffff;
+  Mcp[chip].olat = 0;
+  return true;
+}
+
+void simMcpPinMode(uint8_t chip, uint8_t pin, uint8_t mode)
+{
+  i2cTransfer(14);
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  if (mode == 0x03) Mcp[chip].iodir &= ~(1 << pin);
+  else Mcp[chip].iodir |= 1 << pin;
+}
+
+uint8_t simMcpDigitalRead(uint8_t chip, uint8_t pin)
+{
+  i2cTransfer(4);
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  SimMcp& mcp = Mcp[chip];
+  mcp.intActive = false;
+  uint16_t gpio = (mcp.input & mcp.iodir) | (mcp.olat & ~mcp.iodir);
+  return mcpPinHigh(gpio, pin) ? 1 : 0;
+}
+
+void simMcpDigitalWrite(uint8_t chip, uint8_t pin, uint8_t value)
+{
+  i2cTransfer(7);
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  if (value) Mcp[chip].olat |= 1 << pin;
+  else Mcp[chip].olat &= ~(1 << pin);
+}
+
+uint16_t simMcpReadGPIOAB(uint8_t chip)
+{
+  i2cTransfer(5);
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  SimMcp& mcp = Mcp[chip];
+  mcp.intActive = false;
+  return (mcp.input & mcp.iodir) | (mcp.olat & ~mcp.iodir);
+}
+
+void simMcpWriteGPIOAB(uint8_t chip, uint16_t value)
+{
+  i2cTransfer(4);
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  Mcp[chip].olat = value;
+}
+
+void simMcpSetupInterrupts(uint8_t chip, uint16_t pins, void (*isr)())
+{
+  i2cTransfer(7 * (1 + 2 * __builtin_popcount(pins)) + 5);
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  Mcp[chip].gpinten = pins;
+  Mcp[chip].intActive = false;
+  Mcp_Isr = isr;
+}
+
+uint64_t simI2cBytes()
+{
+  return I2c_Bytes;
+}
+
+int simBlindCount()
+{
+  return Sim_Blinds.size();
+}
+
+const SimBlindSpec& simBlindSpec(int index)
+{
+  return Sim_Blinds[index];
+}
+
+float simBlindPosition(int index)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  return Blind_State[index].travel * 100;
+}
+
+int64_t simBlindStartedUs(int index)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  return Blind_State[index].startedUs;
+}
+
+int64_t simBlindEndstopStopUs(int index)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  return Blind_State[index].endstopStopUs;
+}
+
+bool simBlindMoving(int index)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  return Blind_State[index].moving;
+}
+
+void simWiFiBegin()
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  if (WiFi_Begin_Us < 0) WiFi_Begin_Us = simMicros();
+}
+
+bool simWiFiConnected()
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  return WiFi_Begin_Us >= 0 and simMicros() - WiFi_Begin_Us >= Sim_WiFi_Connect_Ms * 1000LL;
+}
+
+static bool jsonInt(const char* json, const char* key, int* value)
+{ // wystarczające na potrzeby symulatora wyszukanie "klucz": liczba
+  std::string pattern = std::string("\"") + key + "\"";
+  const char* found = strstr(json, pattern.c_str());
+  if (found == NULL) return false;
+  found = strchr(found + pattern.length(), ':');
+  if (found == NULL) return false;
+  *value = atoi(found + 1);
+  return true;
+}
+
+static int apiBlindIndex(int id)
+{
+  for (size_t i = 0; i < Sim_Blinds.size(); i++)
+  {
+    if (Sim_Blinds[i].id == id) return i;
+  }
+  return -1;
+}
+
+static long steadyMs()
+{
+  return simMicros() / 1000;
+}
+
+int simHttpRequest(const char* method, const char* url, const char* payload, const String& token, String* response, bool keepAlive)
+{
+  long started = steadyMs();
+  bool connect;
+  bool available;
+  {
+    std::lock_guard<std::mutex> guard(Sim_Lock);
+    available = Api_Available;
+    connect = !Http_Connection_Open or started - Http_Last_Request_Ms > Sim_Http_Idle_Timeout_Ms;
+    Http_Connection_Open = keepAlive and available;
+  }
+  if (connect) simSleepUs(Sim_Http_Connect_Ms * 1000);
+  if (!available)
+  {
+    std::lock_guard<std::mutex> guard(Sim_Lock);
+    Http_Stats.requests++;
+    Http_Stats.failed++;
+    if (Sim_Verbose) printf("[api] %s %s -> connection refused\n", method, url);
+    return -1; // HTTPC_ERROR_CONNECTION_REFUSED
+  }
+  simSleepUs(Sim_Http_Latency_Ms * 1000);
+
+  const char* path = strstr(url, "://");
+  path = path ? strchr(path + 3, '/') : url;
+  if (path == NULL) return 404;
+
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  char body[8192]; // lista 32 rolet
+  body[0] = 0;
+  int code = 404;
+
+  if (strcmp(method, "POST") == 0 and strcmp(path, "/token/") == 0)
+  {
+    snprintf(body, sizeof(body), "{\"access\":\"%s\",\"refresh\":\"%s\"}", Api_Access_Token, Api_Refresh_Token);
+    code = 200;
+  }
+  else if (strcmp(method, "POST") == 0 and strcmp(path, "/token/refresh/") == 0)
+  {
+    snprintf(body, sizeof(body), "{\"access\":\"%s\"}", Api_Access_Token);
+    code = 200;
+  }
+  else if (token != Api_Access_Token)
+  {
+    snprintf(body, sizeof(body), "{\"detail\":\"Given token not valid for any token type\"}");
+    code = 401;
+  }
+  else if (strcmp(method, "GET") == 0 and strcmp(path, "/configurations/1/") == 0)
+  {
+    size_t len = snprintf(body, sizeof(body), "{\"ntp_server\":\"pool.ntp.org\",\"publish_interval\":1000,\"publish_step\":5,\"pwm_frequency\":1000,\"pwm_resolution\":10,\"speed_ramp\":%d,\"mqtt_server\":\"127.0.0.1\",\"mqtt_port\":1883,\"mqtt_user\":\"sim\",\"mqtt_password\":\"sim\","
+      "\"groups\":[{\"name\":\"salon\",\"blinds\":[3,4]},{\"name\":\"parter\",\"blinds\":[3,4,5,6,7]},{\"name\":\"pietro\",\"blinds\":[20,21]}],"
+      "\"devices\":{\"00\":[", Sim_Speed_Ramp_Ms); // okablowanie rolet symulowanej płytki (DEVICE_ID z src/config_example.h)
+    for (size_t i = 0; i < Sim_Blinds.size() and len < sizeof(body); i++)
+    {
+      const SimBlindSpec& spec = Sim_Blinds[i];
+      len += snprintf(body + len, sizeof(body) - len, "%s{\"id\":%d,\"chip\":%d,\"up\":%d,\"down\":%d,\"sensor_up\":%d,\"sensor_down\":%d,\"speed\":%d}",
+        i ? "," : "", spec.id, spec.chip, spec.upPin, spec.downPin, spec.sensorUpPin, spec.sensorDownPin, spec.speedPin == Sim_No_Speed_Pin ? -1 : spec.speedPin);
+    }
+    if (len < sizeof(body)) snprintf(body + len, sizeof(body) - len, "]}}");
+    code = 200;
+  }
+  else if (strcmp(method, "GET") == 0 and strcmp(path, "/blinds/") == 0)
+  {
+    size_t len = snprintf(body, sizeof(body), "[");
+    for (size_t i = 0; i < Sim_Blinds.size() and len < sizeof(body); i++)
+    {
+      len += snprintf(body + len, sizeof(body) - len, "%s{\"id\":%d,\"position\":%d,\"runtime_up\":%d,\"runtime_down\":%d,\"pass_up\":%d,\"pass_down\":%d,\"speed_table\":%s}",
+        i ? "," : "", Sim_Blinds[i].id, Api_Blinds[i].position, Api_Blinds[i].runtimeUp, Api_Blinds[i].runtimeDown, Sim_Blinds[i].passUp, Sim_Blinds[i].passDown,
+        Sim_Blinds[i].speedPin == Sim_No_Speed_Pin ? "[]" : Sim_Speed_Table);
+    }
+    if (len < sizeof(body)) snprintf(body + len, sizeof(body) - len, "]");
+    code = 200;
+  }
+  else if (strcmp(method, "PATCH") == 0 and strncmp(path, "/blinds/", 8) == 0)
+  {
+    int index = apiBlindIndex(atoi(path + 8));
+    if (index >= 0)
+    {
+      SimApiBlind& blind = Api_Blinds[index];
+      jsonInt(payload, "position", &blind.position);
+      jsonInt(payload, "runtime_up", &blind.runtimeUp);
+      jsonInt(payload, "runtime_down", &blind.runtimeDown);
+      snprintf(body, sizeof(body), "{\"id\":%d,\"position\":%d,\"runtime_up\":%d,\"runtime_down\":%d}",
+        Sim_Blinds[index].id, blind.position, blind.runtimeUp, blind.runtimeDown);
+      code = 200;
+    }
+  }
+
+  long finished = steadyMs();
+  Http_Last_Request_Ms = finished;
+  Http_Stats.requests++;
+  if (connect) Http_Stats.connections++;
+  Http_Stats.totalMs += finished - started;
+  if (Sim_Verbose) printf("[api] %s %s -> %d%s\n", method, path, code, connect ? " (new connection)" : "");
+  if (response) *response = body;
+  return code;
+}
+
+SimHttpStats simHttpStats()
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  return Http_Stats;
+}
+
+void simApiSetAvailable(bool available)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  Api_Available = available;
+  if (Sim_Verbose) printf("[api] server %s\n", available ? "up" : "down");
+}
+
+int simApiPosition(int index)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  return Api_Blinds[index].position;
+}
+
+void simApiRuntimes(int index, int* up, int* down)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  *up = Api_Blinds[index].runtimeUp;
+  *down = Api_Blinds[index].runtimeDown;
+}
+
+static void nvsSave()
+{ // cały plik przy każdym zapisie - wystarczające dla kilku kluczy
+  Nvs_Writes++;
+  if (Sim_Nvs_File == NULL) return;
+  std::ofstream file(Sim_Nvs_File, std::ios::trunc);
+  for (const auto& entry : Nvs_Values) file << entry.first << " " << entry.second << "\n";
+}
+
+bool simNvsGet(const char* key, int32_t* value)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  auto found = Nvs_Values.find(key);
+  if (found == Nvs_Values.end()) return false;
+  *value = atol(found->second.c_str());
+  return true;
+}
+
+void simNvsSet(const char* key, int32_t value)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  Nvs_Values[key] = std::to_string(value);
+  nvsSave();
+  if (Sim_Verbose) printf("[nvs] %s = %d\n", key, value);
+}
+
+bool simNvsGetString(const char* key, char* value, size_t size)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  auto found = Nvs_Values.find(key);
+  if (found == Nvs_Values.end() or found->second.size() >= size) return false;
+  snprintf(value, size, "%s", found->second.c_str());
+  return true;
+}
+
+void simNvsSetString(const char* key, const char* value)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  Nvs_Values[key] = value;
+  nvsSave();
+  if (Sim_Verbose) printf("[nvs] %s = \"%s\"\n", key, value);
+}
+
+void simNvsRemove(const char* key)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  if (Nvs_Values.erase(key) == 0) return;
+  nvsSave();
+  if (Sim_Verbose) printf("[nvs] %s removed\n", key);
+}
+
+uint32_t simNvsWrites()
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  return Nvs_Writes;
+}
+
+uint32_t simJournalSize()
+{
+  return Sim_Journal_Size;
+}
+
+uint32_t simJournalSectorSize()
+{
+  return Sim_Journal_Sector_Size;
+}
+
+bool simJournalRead(uint32_t offset, void* data, size_t size)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  if (offset + size > Sim_Journal_Size) return false;
+  memcpy(data, Journal_Flash.data() + offset, size);
+  return true;
+}
+
+bool simJournalWrite(uint32_t offset, const void* data, size_t size)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  if (offset + size > Sim_Journal_Size) return false;
+  for (size_t i = 0; i < size; i++) Journal_Flash[offset + i] &= ((const uint8_t*)data)[i];
+  Journal_Next = offset + size;
+  journalSave();
+  return true;
+}
+
+bool simJournalErase(uint32_t sector)
+{
+  if ((sector + 1) * Sim_Journal_Sector_Size > Sim_Journal_Size) return false;
+  {
+    std::lock_guard<std::mutex> guard(Sim_Lock);
+    for (const SimBlindState& state : Blind_State)
+    {
+      if (state.moving)
+      {
+        Journal_Erases_Moving++;
+        break;
+      }
+    }
+  }
+  simSleepUs(Sim_Flash_Erase_Ms * 1000);
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  std::fill(Journal_Flash.begin() + sector * Sim_Journal_Sector_Size, Journal_Flash.begin() + (sector + 1) * Sim_Journal_Sector_Size, 0xff);
+  journalSave();
+  if (Sim_Verbose) printf("[flash] sector %u erased\n", sector);
+  return true;
+}
+
+uint32_t simJournalErasesMoving()
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  return Journal_Erases_Moving;
+}
+
+static bool topicMatches(const std::string& filter, const std::string& topic)
+{ // dopasowanie filtra subskrypcji z symbolami + oraz #
+  size_t f = 0, t = 0;
+  while (f < filter.size())
+  {
+    if (filter[f] == '#') return true;
+    if (filter[f] == '+')
+    {
+      while (t < topic.size() and topic[t] != '/') t++;
+      f++;
+      continue;
+    }
+    if (t >= topic.size() or filter[f] != topic[t]) return false;
+    f++;
+    t++;
+  }
+  return t == topic.size();
+}
+
+void simMqttSetup(const char* server, int port, int bufferSize)
+{
+  std::lock_guard<std::mutex> guard(Mqtt_Lock);
+  Mqtt_Buffer_Size = bufferSize;
+}
+
+bool simMqttConnect(const char* id, const char* willTopic, const char* willMessage)
+{
+  std::lock_guard<std::mutex> guard(Mqtt_Lock);
+  Mqtt_Connected = true;
+  Mqtt_Subscriptions.clear();
+  if (Sim_Verbose) printf("[mqtt] %s connected\n", id);
+  return true;
+}
+
+bool simMqttConnected()
+{
+  std::lock_guard<std::mutex> guard(Mqtt_Lock);
+  return Mqtt_Connected;
+}
+
+bool simMqttSubscribe(const char* topic)
+{
+  std::lock_guard<std::mutex> guard(Mqtt_Lock);
+  if (!Mqtt_Connected) return false;
+  Mqtt_Subscriptions.push_back(topic);
+  for (const auto& retained : Mqtt_Retained)
+  {
+    if (topicMatches(topic, retained.first)) Mqtt_Inbox.push_back(retained);
+  }
+  if (!Mqtt_Inbox.empty()) Mqtt_Arrived.notify_all();
+  return true;
+}
+
+bool simMqttPublish(const char* topic, const char* payload, bool retained)
+{
+  std::lock_guard<std::mutex> guard(Mqtt_Lock);
+  if (!Mqtt_Connected) return false;
+  // wiadomości większe niż bufor klienta (5 bajtów nagłówka + 2 długości tematu) hal wysyła strumieniowo (beginPublish)
+  size_t packet = 5 + 2 + strlen(topic) + strlen(payload);
+  Mqtt_Stats.published++;
+  Mqtt_Stats.publishedBytes += packet;
+
+  if (Sim_Verbose) printf("[mqtt] %s %s%s\n", topic, payload, retained ? " (retained)" : "");
+  if (retained) Mqtt_Retained[topic] = payload;
+  Mqtt_Published[topic] = payload;
+  Mqtt_Published_Count[topic]++;
+  for (const auto& filter : Mqtt_Subscriptions)
+  {
+    if (topicMatches(filter, topic))
+    {
+      Mqtt_Inbox.push_back(std::make_pair(std::string(topic), std::string(payload)));
+      Mqtt_Arrived.notify_all();
+      break;
+    }
+  }
+  return true;
+}
+
+void simMqttLoop(SimMqttCallback callback)
+{
+  while (true)
+  {
+    std::pair<std::string, std::string> message;
+    {
+      std::lock_guard<std::mutex> guard(Mqtt_Lock);
+      if (!Mqtt_Connected or Mqtt_Inbox.empty()) return;
+      message = Mqtt_Inbox.front();
+      Mqtt_Inbox.pop_front();
+    }
+    std::vector<char> topic(message.first.begin(), message.first.end());
+    topic.push_back(0);
+    std::vector<uint8_t> payload(message.second.begin(), message.second.end());
+    payload.push_back(0);
+    if (callback == NULL) continue;
+
+    uint32_t allocations = simThreadAllocations();
+    auto started = std::chrono::steady_clock::now();
+    callback(topic.data(), payload.data(), message.second.size());
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    allocations = simThreadAllocations() - allocations;
+
+    std::lock_guard<std::mutex> guard(Mqtt_Lock);
+    Mqtt_Stats.messages++;
+    Mqtt_Stats.callbackNs += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    Mqtt_Stats.allocations += allocations;
+  }
+}
+
+bool simMqttWait(uint32_t timeoutMs)
+{
+  std::unique_lock<std::mutex> guard(Mqtt_Lock);
+  return Mqtt_Arrived.wait_for(guard, std::chrono::microseconds(simRealUs(timeoutMs * 1000LL)), []() { return Mqtt_Connected and !Mqtt_Inbox.empty(); });
+}
+
+void simMqttInject(const char* topic, const char* payload)
+{ // wiadomość od innego klienta brokera
+  std::lock_guard<std::mutex> guard(Mqtt_Lock);
+  if (Sim_Verbose) printf("[mqtt] <- %s %s\n", topic, payload);
+  if (5 + 2 + strlen(topic) + strlen(payload) > (size_t)Mqtt_Buffer_Size)
+  { // PubSubClient pomija wiadomość przychodzącą większą niż bufor
+    if (Sim_Verbose) printf("[mqtt] dropped %s - larger than client buffer %d\n", topic, Mqtt_Buffer_Size);
+    return;
+  }
+  for (const auto& filter : Mqtt_Subscriptions)
+  {
+    if (topicMatches(filter, topic))
+    {
+      Mqtt_Inbox.push_back(std::make_pair(std::string(topic), std::string(payload)));
+      Mqtt_Arrived.notify_all();
+      break;
+    }
+  }
+}
+
+SimMqttStats simMqttStats()
+{
+  std::lock_guard<std::mutex> guard(Mqtt_Lock);
+  return Mqtt_Stats;
+}
+
+String simMqttRetained(const char* topic)
+{
+  std::lock_guard<std::mutex> guard(Mqtt_Lock);
+  auto found = Mqtt_Retained.find(topic);
+  return found == Mqtt_Retained.end() ? String() : String(found->second);
+}
+
+String simMqttLastPublished(const char* topic)
+{
+  std::lock_guard<std::mutex> guard(Mqtt_Lock);
+  auto found = Mqtt_Published.find(topic);
+  return found == Mqtt_Published.end() ? String() : String(found->second);
+}
+
+uint32_t simMqttPublishedCount(const char* topic)
+{
+  std::lock_guard<std::mutex> guard(Mqtt_Lock);
+  auto found = Mqtt_Published_Count.find(topic);
+  return found == Mqtt_Published_Count.end() ? 0 : found->second;
+}
+
+bool simMqttSubscribed(const char* topic)
+{
+  std::lock_guard<std::mutex> guard(Mqtt_Lock);
+  for (const auto& filter : Mqtt_Subscriptions)
+  {
+    if (topicMatches(filter, topic)) return true;
+  }
+  return false;
+}
+
+int simTempCount()
+{
+  return Sim_Temp_Count;
+}
+
+void simTempSetResolution(uint8_t bits)
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  Temp_Resolution = std::max(9, std::min(12, (int)bits));
+}
+
+static bool tempConverted()
+{
+  return Temp_Requested_Us >= 0 and simMicros() - Temp_Requested_Us >= 93750 << (Temp_Resolution - 9);
+}
+
+void simTempRequest()
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  Temp_Has_Value |= tempConverted();
+  Temp_Requested_Us = simMicros();
+}
+
+bool simTempReady()
+{
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  return tempConverted();
+}
+
+float simTempC(int index)
+{ // przed pierwszą zakończoną konwersją rejestr czujnika zawiera wartość po włączeniu zasilania
+  std::lock_guard<std::mutex> guard(Sim_Lock);
+  if (!tempConverted() and !Temp_Has_Value) return 85;
+  float step = 0.5 / (1 << (Temp_Resolution - 9));
+  return floor((21.5 + 0.37 * index) / step) * step;
+}
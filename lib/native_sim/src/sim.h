@@ -0,0 +1,145 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include "WString.h"
+
+// symulowana płytka sterownika: MCP23017 z przekaźnikami i krańcówkami,
+// modele fizyczne rolet, piny PWM ESP32, DS18B20 oraz REST API i broker MQTT
+
+struct SimBlindSpec
+{
+  int id;
+  int chip;               // numer układu MCP23017 (adres 0x20 + chip)
+  uint8_t upPin;          // pin MCP przekaźnika jazdy w górę
+  uint8_t downPin;        // pin MCP przekaźnika jazdy w dół
+  uint8_t sensorUpPin;    // pin MCP krańcówki górnej
+  uint8_t sensorDownPin;  // pin MCP krańcówki dolnej
+  uint8_t speedPin;       // pin ESP sterujący prędkością, 0xff = bez sterowania prędkością
+  int runtimeUp;          // rzeczywisty czas przejazdu 100% -> 0% [ms]
+  int runtimeDown;        // rzeczywisty czas przejazdu 0% -> 100% [ms]
+  int passUp;             // czas przejazdu poza górną krańcówkę zapisany w API [ms]
+  int passDown;           // czas przejazdu poza dolną krańcówkę zapisany w API [ms]
+  int position;           // pozycja początkowa [%]
+};
+
+void simBegin(int argc, char** argv);
+void simWait();
+const char* simBenchName(); // scenariusz z --bench lub NULL
+int simBench(const char* name); // sim_bench.cpp
+void simRestart();
+void simPowerCut(bool tornWrite); // utrata zasilania: przekaźniki puszczają, rolety stają, proces kończy się bez sprzątania
+// tornWrite = zapis flash przerwany w połowie - pierwsze słowo kolejnego rekordu dziennika zaprogramowane losowo
+double simSpeed();
+unsigned simSeed(); // ziarno rand() z --seed N (domyślnie 1)
+
+// zegar urządzenia - z --speed N płynie N razy szybciej od rzeczywistego (testy długotrwałe w skróconym czasie)
+int64_t simMicros(); // czas zegara urządzenia od uruchomienia w us
+void simSleepUs(int64_t us); // uśpienie wątku na czas zegara urządzenia
+int64_t simRealUs(int64_t us); // czas rzeczywisty odpowiadający czasowi zegara urządzenia (timeouty oczekiwań)
+
+bool simVerbose();
+bool simPinning(); // false z --no-pin - xTaskCreatePinnedToCore bez przypięcia wątku
+float simCpuLoad(); // czas procesora zużyty przez proces od poprzedniego wywołania w % czasu rdzeni z --cpus
+bool simSerialEnabled(); // w trybie benchmarku log urządzenia tylko z --verbose
+float simChipTemperature();
+
+// GPIO ESP32, wypełnienie PWM 0..255 (digitalWrite) lub 0..1 (kanał LEDC)
+void simGpioWrite(uint8_t pin, int duty);
+int simGpioRead(uint8_t pin);
+void simPwmWrite(uint8_t pin, float duty);
+
+// MCP23017 - z --blinds N (domyślnie 4, najwyżej 32) po 4 rolety na układ, układy 0..(N-1)/4
+bool simMcpBegin(uint8_t chip); // false dla układu nieobecnego na magistrali
+void simMcpPinMode(uint8_t chip, uint8_t pin, uint8_t mode);
+uint8_t simMcpDigitalRead(uint8_t chip, uint8_t pin);
+void simMcpDigitalWrite(uint8_t chip, uint8_t pin, uint8_t value);
+uint16_t simMcpReadGPIOAB(uint8_t chip);
+void simMcpWriteGPIOAB(uint8_t chip, uint16_t value);
+void simMcpSetupInterrupts(uint8_t chip, uint16_t pins, void (*isr)()); // isr wywoływane z wątku symulacji, wspólne dla układów
+uint64_t simI2cBytes(); // bajty przesłane magistralą I2C od uruchomienia
+
+// modele rolet
+int simBlindCount();
+const SimBlindSpec& simBlindSpec(int index);
+float simBlindPosition(int index); // rzeczywista pozycja w %, poza zakresem 0..100 przy przejeździe za krańcówkę
+bool simBlindMoving(int index);
+int64_t simBlindStartedUs(int index); // ostatni start silnika rolety w us zegara urządzenia
+int64_t simBlindEndstopStopUs(int index); // od zadziałania krańcówki do zatrzymania silnika przy ostatnim zatrzymaniu w us, -1 = zatrzymanie przed krańcówką
+
+// WiFi
+void simWiFiBegin();
+bool simWiFiConnected(); // po Sim_WiFi_Connect_Ms od simWiFiBegin()
+
+// REST API - keepAlive = klient zostawia połączenie otwarte, nowe połączenie kosztuje Sim_Http_Connect_Ms
+struct SimHttpStats
+{
+  uint32_t requests;
+  uint32_t connections;
+  uint32_t failed;
+  uint64_t totalMs;
+};
+int simHttpRequest(const char* method, const char* url, const char* payload, const String& token, String* response, bool keepAlive);
+SimHttpStats simHttpStats();
+void simApiSetAvailable(bool available); // false = awaria serwera, żądania kończą się błędem połączenia
+int simApiPosition(int index); // pozycja rolety zapisana w API
+void simApiRuntimes(int index, int* up, int* down); // czasy przejazdu zapisane w API [ms] - z --runtime-error N różne od rzeczywistych o N %
+
+// NVS - w pamięci albo w pliku z --nvs <plik> (przetrwa ponowne uruchomienie symulatora)
+bool simNvsGet(const char* key, int32_t* value);
+void simNvsSet(const char* key, int32_t value);
+bool simNvsGetString(const char* key, char* value, size_t size);
+void simNvsSetString(const char* key, const char* value);
+void simNvsRemove(const char* key);
+uint32_t simNvsWrites();
+
+// dziennik we flash - 16 sektorów po 4 KB, w pamięci albo w pliku <nvs>.journal z --nvs
+// zapis zeruje tylko bity (jak NOR flash), kasowanie sektora trwa Sim_Flash_Erase_Ms
+uint32_t simJournalSize();
+uint32_t simJournalSectorSize();
+bool simJournalRead(uint32_t offset, void* data, size_t size);
+bool simJournalWrite(uint32_t offset, const void* data, size_t size);
+bool simJournalErase(uint32_t sector);
+uint32_t simJournalErasesMoving(); // kasowania w trakcie jazdy którejkolwiek rolety - wstrzymują tick ruchu
+
+// broker MQTT
+typedef void (*SimMqttCallback)(char*, uint8_t*, unsigned int);
+void simMqttSetup(const char* server, int port, int bufferSize);
+bool simMqttConnect(const char* id, const char* willTopic, const char* willMessage);
+bool simMqttConnected();
+bool simMqttSubscribe(const char* topic);
+bool simMqttPublish(const char* topic, const char* payload, bool retained);
+void simMqttLoop(SimMqttCallback callback);
+bool simMqttWait(uint32_t timeoutMs); // oczekiwanie na wiadomość w skrzynce urządzenia
+void simMqttInject(const char* topic, const char* payload);
+struct SimMqttStats
+{
+  uint32_t messages; // wiadomości dostarczone do callback
+  uint64_t callbackNs; // łączny czas wykonania callback
+  uint32_t allocations; // alokacje sterty wykonane w callback
+  uint32_t published; // wiadomości opublikowane przez urządzenie
+  uint64_t publishedBytes; // bajty pakietów PUBLISH urządzenia (nagłówek, temat i treść)
+};
+SimMqttStats simMqttStats();
+
+// alokacje sterty wykonane przez bieżący wątek od jego startu (sim_alloc.cpp)
+uint32_t simThreadAllocations();
+uint32_t simDeviceAllocations(); // alokacje wykonane przez wszystkie zadania urządzenia (wątki xTaskCreate) od uruchomienia
+void simMarkDeviceThread(); // sim_freertos.cpp - bieżący wątek jest zadaniem urządzenia
+void simPinThreadToCore(int core); // sim_freertos.cpp - bieżący wątek na procesorze hosta rdzenia urządzenia (tskNO_AFFINITY = bez przypięcia)
+// sterta urządzenia odwzorowana na arenie glibc o pojemności Sim_Heap_Size (sim_alloc.cpp)
+uint32_t simHeapFree();
+uint32_t simHeapLargestFreeBlock();
+String simMqttRetained(const char* topic);
+String simMqttLastPublished(const char* topic); // ostatnia wiadomość urządzenia w temacie, także niezachowywana
+uint32_t simMqttPublishedCount(const char* topic); // wiadomości urządzenia w temacie od uruchomienia
+bool simMqttSubscribed(const char* topic); // czy urządzenie odbierze wiadomość z tematu
+
+// DS18B20
+int simTempCount();
+void simTempSetResolution(uint8_t bits);
+void simTempRequest(); // start konwersji na wszystkich czujnikach
+bool simTempReady(); // konwersja zakończona (93.75 ms przy 9 bitach, x2 na każdy kolejny bit)
+float simTempC(int index); // wynik ostatniej konwersji z dokładnością rozdzielczości
+
+#endif
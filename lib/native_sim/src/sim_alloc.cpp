@@ -0,0 +1,68 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <malloc.h>
+#include <atomic>
+
+// licznik alokacji sterty w bieżącym wątku (malloc/calloc/realloc, także operator new)
+// pozwala zmierzyć alokacje wykonane przez kod urządzenia w wybranym fragmencie, np. w callback MQTT
+// oraz łącznie we wszystkich zadaniach urządzenia (bez wątków symulatora i benchmarku)
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+
+static const size_t Sim_Heap_Size = 320 * 1024; // sterta DRAM ESP32 - na hoście korzysta z niej także kod symulatora
+static thread_local uint32_t Thread_Allocations = 0;
+static thread_local bool Device_Thread = false;
+static std::atomic<uint32_t> Device_Allocations{0};
+static const int Single_Arena = mallopt(M_ARENA_MAX, 1); // jedna arena dla wszystkich wątków, jak jedna sterta ESP32
+
+extern "C" void* malloc(size_t size)
+{
+  Thread_Allocations++;
+  if (Device_Thread) Device_Allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+  Thread_Allocations++;
+  if (Device_Thread) Device_Allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size)
+{
+  Thread_Allocations++;
+  if (Device_Thread) Device_Allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(pointer, size);
+}
+
+uint32_t simThreadAllocations()
+{
+  return Thread_Allocations;
+}
+
+uint32_t simDeviceAllocations()
+{
+  return Device_Allocations.load(std::memory_order_relaxed);
+}
+
+void simMarkDeviceThread()
+{
+  Device_Thread = true;
+}
+
+uint32_t simHeapFree()
+{ // pojemność minus zajęte bloki (w arenie i mapowane osobno)
+  struct mallinfo2 info = mallinfo2();
+  size_t used = info.uordblks + info.hblkhd;
+  return used < Sim_Heap_Size ? Sim_Heap_Size - used : 0;
+}
+
+uint32_t simHeapLargestFreeBlock()
+{ // ciągły obszar za szczytem areny - wolne dziury wewnątrz areny to fragmentacja
+  struct mallinfo2 info = mallinfo2();
+  size_t used = info.arena - info.keepcost + info.hblkhd;
+  return used < Sim_Heap_Size ? Sim_Heap_Size - used : 0;
+}
@@ -0,0 +1,1097 @@
+#include "Arduino.h"
+#include "sim.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// scenariusze benchmarków uruchamiane opcją --bench <nazwa> na symulowanej płytce
+
+class CpuLoad
+{ // syntetyczne obciążenie procesora - wątki liczące bez przerwy
+public:
+  void start(int threads, int core = tskNO_AFFINITY)
+  { // core - wątki na procesorze hosta rdzenia urządzenia (simPinThreadToCore)
+    running_ = true;
+    for (int i = 0; i < threads; i++)
+    {
+      threads_.emplace_back([this, core]() {
+        simPinThreadToCore(core);
+        volatile uint64_t x = 0;
+        while (running_) x = x * 6364136223846793005ULL + 1;
+      });
+    }
+  }
+
+  void stop()
+  {
+    running_ = false;
+    for (auto& thread : threads_) thread.join();
+    threads_.clear();
+  }
+
+private:
+  std::atomic<bool> running_{false};
+  std::vector<std::thread> threads_;
+};
+
+static void sleepMs(int ms)
+{ // czas zegara urządzenia (--speed)
+  simSleepUs(ms * 1000LL);
+}
+
+static bool waitReady(int blindIndex, int timeoutMs)
+{ // urządzenie jest gotowe, gdy subskrybuje nastawy i opublikowało status
+  char topic[48];
+  snprintf(topic, sizeof(topic), "ssh/blinds/set/%d", simBlindSpec(blindIndex).id);
+  for (int waited = 0; waited < timeoutMs; waited += 50)
+  {
+    if (simMqttSubscribed(topic))
+    {
+      sleepMs(500); // uruchomienie zadań po connectMqtt()
+      return true;
+    }
+    sleepMs(50);
+  }
+  return false;
+}
+
+static int reportedStep(int blindIndex)
+{ // ostatnia pozycja opublikowana przez urządzenie w ssh/blinds/run/<id>
+  char topic[48];
+  snprintf(topic, sizeof(topic), "ssh/blinds/run/%d", simBlindSpec(blindIndex).id);
+  String message = simMqttRetained(topic);
+  int index = message.indexOf("\"step\"");
+  if (index < 0) return -1;
+  return atoi(message.c_str() + message.indexOf(':', index) + 1);
+}
+
+static double nowMs()
+{
+  return simMicros() / 1000.0;
+}
+
+static void sendSet(int blindIndex, int target, int speed = 100)
+{ // nastawa z czasem wysłania "ts" - urządzenie liczy z niego opóźnienie MQTT
+  char topic[48];
+  char payload[96];
+  long long sent = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  snprintf(topic, sizeof(topic), "ssh/blinds/set/%d", simBlindSpec(blindIndex).id);
+  snprintf(payload, sizeof(payload), "{\"set\":%d,\"speed\":%d,\"calibrate\":false,\"ts\":%lld}", target, speed, sent);
+  simMqttInject(topic, payload);
+}
+
+static bool waitStopped(int blindIndex, int target, int timeoutMs)
+{ // roleta stoi, a urządzenie opublikowało pozycję docelową
+  int stable = 0;
+  for (int waited = 0; waited < timeoutMs; waited += 20)
+  {
+    stable = (!simBlindMoving(blindIndex) and reportedStep(blindIndex) == target) ? stable + 20 : 0;
+    if (stable >= 300) return true;
+    sleepMs(20);
+  }
+  return false;
+}
+
+static bool moveBlind(int blindIndex, int target, int timeoutMs)
+{ // zlecenie przejazdu przez MQTT i oczekiwanie na zatrzymanie rolety z opublikowaną pozycją docelową
+  sendSet(blindIndex, target);
+  sleepMs(300);
+  return waitStopped(blindIndex, target, timeoutMs);
+}
+
+static float positionError(int blindIndex, int target)
+{ // błąd pozycji fizycznej względem nastawy - przy nastawie krańcowej roleta stoi za krańcówką (pass), co błędem nie jest
+  float position = simBlindPosition(blindIndex);
+  if (target == 0 or target == 100) position = std::max(0.0f, std::min(100.0f, position));
+  return position - target;
+}
+
+static double commandLatencyMs(int blindIndex, int target)
+{ // czas od publikacji nastawy do załączenia przekaźnika silnika
+  double sent = nowMs();
+  sendSet(blindIndex, target);
+  while (!simBlindMoving(blindIndex) and nowMs() - sent < 5000) std::this_thread::sleep_for(std::chrono::microseconds(100));
+  return nowMs() - sent;
+}
+
+static int benchPosition()
+{ // błąd pozycji fizycznej po serii przejazdów, bez obciążenia i przy obciążeniu CPU
+  const int blind = 0;
+  const int targets[] = {40, 90, 20, 65, 5, 50, 0};
+  const int loadThreads = std::thread::hardware_concurrency();
+
+  if (!waitReady(blind, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+
+  int result = 0;
+  for (int loaded = 0; loaded < 2; loaded++)
+  {
+    CpuLoad load;
+    if (loaded) load.start(loadThreads);
+
+    float sumError = 0;
+    float maxError = 0;
+    int from = reportedStep(blind);
+    for (int target : targets)
+    {
+      bool done = moveBlind(blind, target, 60000);
+      float error = positionError(blind, target);
+      printf("position load=%d move=%d->%d error=%.3f%%%s\n", loaded ? loadThreads : 0, from, target, error, done ? "" : " timeout");
+      sumError += fabs(error);
+      maxError = max(maxError, fabs(error));
+      from = target;
+      if (!done) result = 1;
+    }
+    printf("position load=%d mean_abs_error=%.3f%% max_abs_error=%.3f%%\n", loaded ? loadThreads : 0, sumError / (sizeof(targets) / sizeof(targets[0])), maxError);
+
+    if (loaded) load.stop();
+  }
+  return result;
+}
+
+static int benchSpeed()
+{ // błąd pozycji fizycznej po przejazdach z obniżoną prędkością (silnik symulacji nieliniowy - pozycja z kalibracji prędkości)
+  // i po zmianie prędkości w trakcie jazdy; z --ramp ms także z rampą wypełnienia
+  const int blind = 0;
+  const int speeds[] = {100, 85, 70};
+  const int targets[] = {80, 20, 60, 0};
+
+  if (!waitReady(blind, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+  sleepMs(1000);
+
+  int result = 0;
+  for (int speed : speeds)
+  {
+    float maxError = 0;
+    double started = nowMs();
+    for (int target : targets)
+    {
+      sendSet(blind, target, speed);
+      sleepMs(300);
+      if (!waitStopped(blind, target, 60000)) result = 1;
+      maxError = max(maxError, fabsf(positionError(blind, target)));
+    }
+    printf("speed speed=%d moves=%d max_abs_error=%.3f%% time_ms=%.0f\n", speed, int(sizeof(targets) / sizeof(targets[0])), maxError, nowMs() - started);
+  }
+
+  sendSet(blind, 90, 70);
+  sleepMs(2500);
+  sendSet(blind, 90, 100);
+  bool done = waitStopped(blind, 90, 60000);
+  printf("speed change=70->100 error=%.3f%%%s\n", simBlindPosition(blind) - 90, done ? "" : " timeout");
+  if (!done) result = 1;
+  moveBlind(blind, 0, 60000);
+  return result;
+}
+
+static int benchLatency()
+{ // czas od publikacji nastawy do załączenia przekaźnika silnika
+  const int blind = 0;
+  const int samples = 20;
+
+  if (!waitReady(blind, 30000) or !moveBlind(blind, 30, 60000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+
+  std::vector<double> latencies;
+  for (int i = 0; i < samples; i++)
+  {
+    int target = i % 2 ? 30 : 32;
+    double latency = commandLatencyMs(blind, target);
+    latencies.push_back(latency);
+    printf("latency sample=%d command_to_motor=%.2fms\n", i, latency);
+    if (!waitStopped(blind, target, 60000)) return 1;
+    sleepMs(37 * (i % 5)); // różne fazy względem okresów zadań urządzenia
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  double sum = 0;
+  for (double latency : latencies) sum += latency;
+  printf("latency mean=%.2fms p50=%.2fms max=%.2fms\n", sum / samples, latencies[samples / 2], latencies.back());
+  return 0;
+}
+
+static int benchHttp()
+{ // liczba nowych połączeń i średni czas żądań API przy seriach aktualizacji pozycji
+  const int rounds = 3;
+
+  if (!waitReady(0, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+  sleepMs(1000);
+  SimHttpStats before = simHttpStats();
+
+  for (int round = 0; round < rounds; round++)
+  {
+    for (int blind = 0; blind < simBlindCount(); blind++)
+    {
+      if (!moveBlind(blind, 2 + 2 * (round % 2), 60000)) return 1;
+    }
+  }
+  sleepMs(1500); // ostatni PATCH z apiUpdatePosition
+
+  SimHttpStats after = simHttpStats();
+  uint32_t requests = after.requests - before.requests;
+  uint32_t connections = after.connections - before.connections;
+  printf("http requests=%u connections=%u mean_request_ms=%.1f\n", requests, connections, requests ? double(after.totalMs - before.totalMs) / requests : 0.0);
+  return 0;
+}
+
+static int benchOutage()
+{ // awaria API w trakcie przejazdów: liczba prób w czasie awarii, zapisy NVS i czas zbieżności po powrocie serwera
+  const int outageMs = 30000;
+  const int targets[] = {10, 20, 30, 40};
+
+  if (!waitReady(0, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+  sleepMs(1000);
+
+  simApiSetAvailable(false);
+  SimHttpStats before = simHttpStats();
+  uint32_t nvsBefore = simNvsWrites();
+  double outageStart = nowMs();
+  for (int blind = 0; blind < simBlindCount(); blind++)
+  {
+    if (!moveBlind(blind, 5, 60000)) return 1; //pozycja pośrednia - nadpisana w kolejce przez kolejną
+    if (!moveBlind(blind, targets[blind], 60000)) return 1;
+  }
+  sleepMs(max(0, int(outageMs - (nowMs() - outageStart))));
+
+  int stored = 0;
+  for (int blind = 0; blind < simBlindCount(); blind++)
+  {
+    char key[16];
+    int32_t value;
+    snprintf(key, sizeof(key), "pos%d", simBlindSpec(blind).id);
+    if (simNvsGet(key, &value) and value == targets[blind]) stored++;
+  }
+  SimHttpStats during = simHttpStats();
+
+  simApiSetAvailable(true);
+  double restored = nowMs();
+  bool converged = false;
+  while (!converged and nowMs() - restored < 120000)
+  {
+    converged = true;
+    for (int blind = 0; blind < simBlindCount(); blind++) converged &= simApiPosition(blind) == targets[blind];
+    if (!converged) sleepMs(10);
+  }
+
+  printf("outage duration_ms=%d failed_requests=%u nvs_writes=%u nvs_pending=%d/%d\n", outageMs, during.failed - before.failed, simNvsWrites() - nvsBefore, stored, simBlindCount());
+  printf("outage converged=%d converge_ms=%.0f\n", converged, nowMs() - restored);
+  return converged ? 0 : 1;
+}
+
+static int benchParser()
+{ // seria poleceń sceny: przepustowość callback i alokacje sterty na wiadomość
+  const int messages = 4000;
+
+  if (!waitReady(0, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+  sleepMs(500);
+
+  SimMqttStats before = simMqttStats();
+  for (int i = 0; i < messages; i++)
+  {
+    char topic[48];
+    char payload[96];
+    snprintf(topic, sizeof(topic), "ssh/blinds/set/%d", simBlindSpec(i % simBlindCount()).id);
+    snprintf(payload, sizeof(payload), "{\"id\": %d, \"set\": %d, \"speed\": 100, \"calibrate\": false, \"scene\": \"evening\"}", simBlindSpec(i % simBlindCount()).id, 40 + i % 3);
+    simMqttInject(topic, payload);
+  }
+
+  SimMqttStats after = simMqttStats();
+  for (int waited = 0; after.messages - before.messages < (uint32_t)messages and waited < 30000; waited += 10)
+  {
+    sleepMs(10);
+    after = simMqttStats();
+  }
+
+  uint32_t delivered = after.messages - before.messages;
+  double seconds = (after.callbackNs - before.callbackNs) / 1e9;
+  printf("parser messages=%u msg_per_s=%.0f us_per_msg=%.2f allocs_per_msg=%.2f\n", delivered, delivered / max(seconds, 1e-9), seconds * 1e6 / max(delivered, 1u), double(after.allocations - before.allocations) / max(delivered, 1u));
+  return delivered == (uint32_t)messages ? 0 : 1;
+}
+
+static int benchSoak()
+{ // 30 dni pracy (z --speed N w skróconym czasie): przejazd co godzinę, stan sterty raz na dobę
+  // dryf liczony od końca pierwszej doby - do tego czasu każde zadanie okresowe (także dobowe tokeny) wykonało się raz
+  const int days = 30;
+  const double hourMs = 3600.0 * 1000;
+
+  if (!waitReady(0, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+  printf("soak day=0 free=%u largest=%u\n", simHeapFree(), simHeapLargestFreeBlock());
+
+  uint32_t baseFree = 0;
+  uint32_t baseLargest = 0;
+  uint32_t minLargest = UINT32_MAX;
+  double start = nowMs();
+  int moves = 0;
+  int failed = 0;
+  for (int day = 1; day <= days; day++)
+  {
+    for (int hour = 0; hour < 24; hour++)
+    {
+      if (!moveBlind(moves % simBlindCount(), (moves * 37) % 101, 120000)) failed++;
+      moves++;
+      sleepMs(max(0, int(start + ((day - 1) * 24 + hour + 1) * hourMs - nowMs())));
+      if (day > 1) minLargest = min(minLargest, simHeapLargestFreeBlock());
+    }
+    printf("soak day=%d free=%u largest=%u\n", day, simHeapFree(), simHeapLargestFreeBlock());
+    if (day == 1)
+    {
+      baseFree = simHeapFree();
+      baseLargest = simHeapLargestFreeBlock();
+    }
+  }
+
+  printf("soak days=%d moves=%d failed_moves=%d free_drift=%d largest_drift=%d min_largest=%u\n", days, moves, failed,
+    int(simHeapFree() - baseFree), int(simHeapLargestFreeBlock() - baseLargest), minLargest);
+  return 0;
+}
+
+static int benchTelemetry()
+{ // ruch MQTT urządzenia bez przejazdów rolet (opis i telemetria) w przeliczeniu na godzinę
+  const int hours = 6;
+
+  if (!waitReady(0, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+  sleepMs(1000);
+
+  SimMqttStats before = simMqttStats();
+  sleepMs(hours * 3600 * 1000);
+  SimMqttStats after = simMqttStats();
+  uint32_t messages = after.published - before.published;
+  printf("telemetry hours=%d messages_per_hour=%.1f bytes_per_hour=%.0f\n", hours, double(messages) / hours, double(after.publishedBytes - before.publishedBytes) / hours);
+  return 0;
+}
+
+static int benchBoot()
+{ // czas od włączenia do gotowości przy API niedostępnym przez pierwsze 30 s
+  // z --nvs <plik> pierwsze uruchomienie zapisuje stan w NVS, a kolejne startuje z niego bez API
+  // start z NVS: pełny przejazd bez API koryguje czas przejazdu w górę (z --runtime-error N) - po synchronizacji
+  // z API w API ma trafić korekta, a nie wrócić czas sprzed niej
+  const int outageMs = 30000;
+  const int blind = 0;
+  const SimBlindSpec& spec = simBlindSpec(blind);
+  char topic[48];
+  snprintf(topic, sizeof(topic), "ssh/blinds/set/%d", spec.id);
+  int runtimeUp, runtimeDown;
+  simApiRuntimes(blind, &runtimeUp, &runtimeDown);
+
+  simApiSetAvailable(false);
+  bool apiDown = true;
+  double readyMs = -1;
+  while (readyMs < 0 and nowMs() < outageMs + 30000)
+  {
+    if (apiDown and nowMs() >= outageMs)
+    {
+      simApiSetAvailable(true);
+      apiDown = false;
+    }
+    if (simMqttSubscribed(topic)) readyMs = nowMs();
+    else sleepMs(1);
+  }
+  if (readyMs < 0)
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+
+  sleepMs(500); // uruchomienie zadań po connectMqtt()
+  int target = simBlindPosition(blind) > 50 ? 20 : 80;
+  bool moved = moveBlind(blind, target, 60000);
+  bool movedOffline = moved and apiDown;
+  if (movedOffline)
+  { // krańcówka dolna, potem pełny przejazd w górę - korekta czasu przejazdu bez API; pozycja końcowa różna od API
+    target = 30;
+    moved &= moveBlind(blind, 100, 60000) and moveBlind(blind, 0, 60000) and moveBlind(blind, target, 60000);
+  }
+  if (apiDown)
+  {
+    sleepMs(max(0, int(outageMs - nowMs())));
+    simApiSetAvailable(true);
+  }
+  double restored = nowMs();
+  while (simApiPosition(blind) != target and nowMs() - restored < 120000) sleepMs(10);
+  double synced = nowMs() - restored;
+  sleepMs(1000); // wysyłka czasów przejazdu po pozycji
+  int syncedUp, syncedDown;
+  simApiRuntimes(blind, &syncedUp, &syncedDown);
+  char key[16];
+  int32_t storedUp = -1;
+  snprintf(key, sizeof(key), "rtu%d", spec.id);
+  simNvsGet(key, &storedUp); // stan startowy kolejnego uruchomienia zgodny z API
+  bool runtimeKept = storedUp == syncedUp
+    and (!movedOffline or runtimeUp == spec.runtimeUp or abs(syncedUp - spec.runtimeUp) < abs(runtimeUp - spec.runtimeUp));
+
+  printf("boot ready_ms=%.0f moved_offline=%d api_synced=%d sync_after_restore_ms=%.0f runtime_up_error=%.2f%%->%.2f%%%s\n",
+    readyMs, movedOffline, simApiPosition(blind) == target, synced,
+    100.0 * (runtimeUp - spec.runtimeUp) / spec.runtimeUp, 100.0 * (syncedUp - spec.runtimeUp) / spec.runtimeUp, runtimeKept ? "" : " lost");
+  return moved and simApiPosition(blind) == target and runtimeKept ? 0 : 1;
+}
+
+static double startSkewMs(const int64_t* before)
+{ // rozrzut chwil startu silników wszystkich rolet od ostatniego polecenia
+  int64_t first = INT64_MAX;
+  int64_t last = 0;
+  for (int i = 0; i < simBlindCount(); i++)
+  {
+    int64_t started = simBlindStartedUs(i);
+    if (started == before[i]) return -1; // roleta nie ruszyła
+    first = std::min(first, started);
+    last = std::max(last, started);
+  }
+  return (last - first) / 1000.0;
+}
+
+static int benchGroup()
+{ // rozrzut startu rolet przy osobnych wiadomościach, poleceniu grupy i scenie
+  const int count = simBlindCount();
+  if (!waitReady(0, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+
+  int result = 0;
+  const char* modes[] = {"individual", "group", "scene"};
+  const int targets[] = {60, 20, 80};
+  for (int mode = 0; mode < 3; mode++)
+  {
+    int64_t before[32];
+    for (int i = 0; i < count; i++) before[i] = simBlindStartedUs(i);
+
+    int messages = 1;
+    if (mode == 0)
+    {
+      for (int i = 0; i < count; i++) sendSet(i, targets[mode]);
+      messages = count;
+    }
+    else if (mode == 1)
+    {
+      simMqttInject("ssh/blinds/set/group/parter", "{\"set\":20,\"speed\":100}");
+    }
+    else
+    {
+      char payload[256];
+      size_t length = snprintf(payload, sizeof(payload), "{\"blinds\":[");
+      for (int i = 0; i < count; i++)
+      {
+        length += snprintf(payload + length, sizeof(payload) - length, "%s{\"id\":%d,\"set\":%d}", i ? "," : "", simBlindSpec(i).id, targets[mode]);
+      }
+      snprintf(payload + length, sizeof(payload) - length, "]}");
+      simMqttInject("ssh/blinds/set/scene", payload);
+    }
+
+    sleepMs(300);
+    double skew = startSkewMs(before);
+    bool done = true;
+    for (int i = 0; i < count; i++) done &= waitStopped(i, targets[mode], 60000);
+    printf("group mode=%s messages=%d start_skew_ms=%.1f%s\n", modes[mode], messages, skew, done and skew >= 0 ? "" : " failed");
+    if (!done or skew < 0) result = 1;
+  }
+  return result;
+}
+
+static int benchScale()
+{ // wszystkie rolety płytki (--blinds N, do 8 układów MCP) w jednej scenie: rozrzut startu, błąd pozycji i obciążenie I2C
+  const int count = simBlindCount();
+  if (!waitReady(count - 1, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+
+  int result = 0;
+  const int targets[] = {40, 0, 75};
+  for (int target : targets)
+  {
+    int64_t before[32];
+    for (int i = 0; i < count; i++) before[i] = simBlindStartedUs(i);
+    char payload[1024];
+    size_t length = snprintf(payload, sizeof(payload), "{\"blinds\":[");
+    for (int i = 0; i < count; i++)
+    {
+      length += snprintf(payload + length, sizeof(payload) - length, "%s{\"id\":%d,\"set\":%d}", i ? "," : "", simBlindSpec(i).id, target);
+    }
+    snprintf(payload + length, sizeof(payload) - length, "]}");
+    uint64_t bytes = simI2cBytes();
+    int64_t started = simMicros();
+    simMqttInject("ssh/blinds/set/scene", payload);
+
+    sleepMs(300);
+    double skew = startSkewMs(before);
+    bool done = true;
+    for (int i = 0; i < count; i++) done &= waitStopped(i, target, 60000);
+    double seconds = (simMicros() - started) / 1e6;
+    float maxError = 0;
+    for (int i = 0; i < count; i++) maxError = std::max(maxError, fabsf(positionError(i, target)));
+    printf("scale blinds=%d target=%d start_skew_ms=%.1f max_abs_error=%.3f%% i2c_bytes_per_s=%.0f%s\n",
+      count, target, skew, maxError, (simI2cBytes() - bytes) / seconds, done and skew >= 0 ? "" : " failed");
+    if (!done or skew < 0) result = 1;
+  }
+  return result;
+}
+
+static bool requestMetrics(String* metrics)
+{ // metryki na żądanie (ssh/devices/metrics/<id>/get) - nowa wiadomość różna od poprzedniej
+  String previous = simMqttLastPublished("ssh/devices/metrics/00");
+  simMqttInject("ssh/devices/metrics/00/get", "");
+  for (int waited = 0; waited < 2000; waited += 50)
+  {
+    sleepMs(50);
+    *metrics = simMqttLastPublished("ssh/devices/metrics/00");
+    if (metrics->length() > 0 and *metrics != previous) return true;
+  }
+  return false;
+}
+
+static bool metricsHistogram(const String& metrics, const char* loop, const char* name, uint32_t* counts)
+{ // liczności przedziałów histogramu (Histogram::format) z metryk, np. "motion" / "jitter"
+  char key[24];
+  snprintf(key, sizeof(key), "\"%s\":{", loop);
+  int index = metrics.indexOf(key);
+  snprintf(key, sizeof(key), "\"%s\":{", name);
+  index = index < 0 ? -1 : metrics.indexOf(key, index);
+  index = index < 0 ? -1 : metrics.indexOf("\"h\":[", index);
+  if (index < 0) return false;
+  const char* cursor = metrics.c_str() + index + 5;
+  for (int i = 0; i < 16; i++)
+  {
+    counts[i] = 0;
+    if (*cursor != ']') counts[i] = strtoul(cursor, (char**)&cursor, 10);
+    if (*cursor == ',') cursor++;
+  }
+  return true;
+}
+
+static uint32_t histogramPercentile(const uint32_t* before, const uint32_t* after, int percent)
+{ // górna granica przedziału z percentylem różnicy dwóch odczytów histogramu w us (przedziały 64 us << i)
+  uint32_t total = 0;
+  for (int i = 0; i < 16; i++) total += after[i] - before[i];
+  uint64_t wanted = (uint64_t(total) * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (int i = 0; i < 15; i++)
+  {
+    seen += after[i] - before[i];
+    if (total > 0 and seen >= wanted) return 64u << i;
+  }
+  return total > 0 ? UINT32_MAX : 0;
+}
+
+static int benchMetrics()
+{ // metryki urządzenia po przejazdach wszystkich rolet z poleceniami MQTT i wysyłką pozycji do API
+  const int count = simBlindCount();
+  if (!waitReady(0, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+  const int targets[] = {70, 10};
+  for (int target : targets)
+  {
+    for (int i = 0; i < count; i++) sendSet(i, target);
+    sleepMs(300);
+    for (int i = 0; i < count; i++) waitStopped(i, target, 60000);
+  }
+  sleepMs(2000); // wysyłka pozycji do API
+
+  String metrics;
+  if (!requestMetrics(&metrics))
+  {
+    printf("metrics not published\n");
+    return 1;
+  }
+  printf("metrics bytes=%u\n%s\n", (unsigned)metrics.length(), metrics.c_str());
+
+  sleepMs(200); // dryf rolet publikowany po metrykach, po wiadomości na roletę
+  int result = 0;
+  unsigned driftMax = 0;
+  for (int i = 0; i < count; i++)
+  {
+    char topic[48];
+    snprintf(topic, sizeof(topic), "ssh/devices/metrics/00/drift/%d", simBlindSpec(i).id);
+    String drift = simMqttLastPublished(topic);
+    if (drift.length() == 0)
+    {
+      printf("drift not published id=%d\n", simBlindSpec(i).id);
+      result = 1;
+    }
+    driftMax = max(driftMax, (unsigned)drift.length());
+    if (i == 0) printf("%s\n", drift.c_str());
+  }
+  printf("metrics drift_messages=%d drift_max_bytes=%u\n", count, driftMax);
+  return result;
+}
+
+static int benchPowercutRound()
+{ // jeden cykl benchmarku powercut: start po utracie zasilania, kontrolny przejazd, przejazd przerwany odcięciem zasilania
+  // urządzenie z błędnie odtworzoną pozycją zatrzyma roletę przesuniętą o ten błąd względem nastawy
+  const int blind = 0;
+  const SimBlindSpec& spec = simBlindSpec(blind);
+  if (!waitReady(blind, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+
+  int check; // z dala od pozycji po starcie - bez jazdy urządzenie nie publikuje pozycji, na którą czeka moveBlind
+  do check = 10 + rand() % 81; while (fabs(check - simBlindPosition(blind)) < 5);
+  bool done = moveBlind(blind, check, 20000);
+  float rest = simBlindPosition(blind);
+  printf("powercut recovered error=%.3f%s\n", rest - check, done ? "" : " timeout");
+
+  int target;
+  do target = rand() % 101; while (abs(target - check) < 30);
+  int travelMs = abs(target - check) * (target < check ? spec.runtimeUp : spec.runtimeDown) / 100;
+  int cutMs = rand() % (travelMs + travelMs / 4); // część cykli kończy się już po zatrzymaniu rolety
+  bool torn = rand() % 3 == 0;
+  sendSet(blind, target);
+  sleepMs(cutMs);
+  printf("powercut cut at_ms=%d moving=%d torn=%d displacement=%.3f erases_moving=%u\n", cutMs, simBlindMoving(blind), torn, simBlindPosition(blind) - rest, simJournalErasesMoving());
+  simPowerCut(torn);
+  return 0;
+}
+
+static int benchPowercut()
+{ // utrata zasilania w losowych chwilach przejazdu - każdy cykl to nowy proces symulatora z tym samym NVS, dziennikiem flash i rolet
+  // przyrost błędu pozycji po starcie z dziennikiem porównany z przesunięciem rolety od ostatniego postoju (błąd bez dziennika)
+  // cykl n z ziarnem --seed + n - ten sam przebieg przy tym samym ziarnie
+  const int rounds = 20;
+  // dziennik szacuje pozycję ze środka przedziału od ostatniego wpisu: (Journal_Checkpoint_Ms 250 + Journal_Write_Interval_Ms 100) / 2
+  // jazdy szybszym kierunkiem, zapas na zaokrąglenie pozycji do 1% i dokładność kontrolnego przejazdu
+  const SimBlindSpec& spec = simBlindSpec(0);
+  const float errorMax = (250 + 100) / 2.0 * 100 / min(spec.runtimeUp, spec.runtimeDown) + 1.0;
+  char nvs[64];
+  snprintf(nvs, sizeof(nvs), "/tmp/ssh_rolety_powercut_%d.nvs", getpid());
+  for (const char* suffix : {"", ".blinds", ".journal"}) unlink((std::string(nvs) + suffix).c_str());
+
+  char program[128] = {};
+  if (readlink("/proc/self/exe", program, sizeof(program) - 1) <= 0) return 1;
+  char command[320];
+
+  int result = 0;
+  int afterMoving = 0;
+  float sumError = 0;
+  float maxError = 0;
+  float sumDisplacement = 0;
+  bool lastMoving = false;
+  float lastDisplacement = 0;
+  float lastError = 0; // błąd narasta między cyklami - roleta nie wraca do krańcówki
+  unsigned erasesMoving = 0; // kasowania sektora dziennika wstrzymujące tick ruchu
+  for (int round = 0; round <= rounds; round++)
+  {
+    snprintf(command, sizeof(command), "%s --bench powercut-round --nvs %s --speed %g --seed %u%s", program, nvs, simSpeed(), simSeed() + round, simVerbose() ? " --verbose" : "");
+    FILE* child = popen(command, "r");
+    char line[256];
+    while (child != NULL and fgets(line, sizeof(line), child))
+    {
+      float error;
+      int moving;
+      int torn;
+      int cutMs;
+      float displacement;
+      unsigned erases;
+      if (sscanf(line, "powercut recovered error=%f", &error) == 1)
+      {
+        if (strstr(line, "timeout")) result = 1;
+        float added = error - lastError;
+        lastError = error;
+        printf("powercut round=%d after_moving=%d added_error=%.3f %s", round, round > 0 and lastMoving, added, line + strlen("powercut "));
+        if (round > 0 and lastMoving)
+        {
+          afterMoving++;
+          sumError += fabs(added);
+          maxError = max(maxError, fabs(added));
+          sumDisplacement += fabs(lastDisplacement);
+        }
+      }
+      else if (sscanf(line, "powercut cut at_ms=%d moving=%d torn=%d displacement=%f erases_moving=%u", &cutMs, &moving, &torn, &displacement, &erases) == 5)
+      {
+        erasesMoving += erases;
+        printf("powercut round=%d %s", round, line + strlen("powercut "));
+        lastMoving = moving;
+        lastDisplacement = displacement;
+      }
+      else if (strncmp(line, "device not ready", 16) == 0)
+      {
+        printf("powercut round=%d %s", round, line);
+        result = 1;
+      }
+    }
+    if (child == NULL or pclose(child) != 0) result = 1;
+  }
+  for (const char* suffix : {"", ".blinds", ".journal"}) unlink((std::string(nvs) + suffix).c_str());
+
+  printf("powercut seed=%u rounds=%d cut_while_moving=%d mean_abs_error=%.3f%% max_abs_error=%.3f%% bound=%.3f%% mean_abs_error_without_journal=%.3f%% erases_while_moving=%u\n",
+    simSeed(), rounds, afterMoving, afterMoving ? sumError / afterMoving : 0, maxError, errorMax, afterMoving ? sumDisplacement / afterMoving : 0, erasesMoving);
+  if (maxError > errorMax)
+  {
+    printf("powercut max_abs_error above bound\n");
+    result = 1;
+  }
+  return result;
+}
+
+static void suiteResult(const char* scenario, const char* metric, double value, const char* unit, const char* extra = "")
+{ // jeden wynik w wierszu JSON - porównywalny między przebiegami (CI, przed wydaniem firmware)
+  printf("{\"bench\":\"suite\",\"scenario\":\"%s\",\"metric\":\"%s\",\"value\":%.3f,\"unit\":\"%s\"%s}\n", scenario, metric, value, unit, extra);
+}
+
+static void suiteSummary(const char* scenario, const char* metric, std::vector<double> values, const char* unit)
+{ // średnia, mediana i maksimum z próbek scenariusza
+  if (values.empty()) return;
+  std::sort(values.begin(), values.end());
+  double sum = 0;
+  for (double value : values) sum += value;
+  char name[48];
+  snprintf(name, sizeof(name), "%s_mean", metric);
+  suiteResult(scenario, name, sum / values.size(), unit);
+  snprintf(name, sizeof(name), "%s_p50", metric);
+  suiteResult(scenario, name, values[values.size() / 2], unit);
+  snprintf(name, sizeof(name), "%s_max", metric);
+  suiteResult(scenario, name, values.back(), unit);
+}
+
+static int benchSuite()
+{ // stały zestaw scenariuszy z wynikami w wierszach JSON: dokładność pozycji, opóźnienie polecenia,
+  // zatrzymanie na krańcówce, przepustowość MQTT i alokacje sterty na operację
+  const int positionBlind = 0;
+  const int positionTargets[] = {40, 90, 20, 65, 5, 50};
+  const int latencySamples = 10;
+  const int endstopBlind = 1;
+  const int endstopTargets[] = {100, 0, 100, 0};
+  const int messages = 2000;
+
+  if (!waitReady(positionBlind, 30000))
+  {
+    suiteResult("suite", "ready", 0, "bool");
+    return 1;
+  }
+  sleepMs(500);
+  int failures = 0;
+  char extra[64];
+
+  std::vector<double> errors;
+  uint32_t allocationsBefore = simDeviceAllocations();
+  int from = lroundf(simBlindPosition(positionBlind));
+  for (int target : positionTargets)
+  {
+    if (!moveBlind(positionBlind, target, 60000)) failures++;
+    double error = positionError(positionBlind, target);
+    snprintf(extra, sizeof(extra), ",\"from\":%d,\"to\":%d", from, target);
+    suiteResult("position", "error", error, "%", extra);
+    errors.push_back(fabs(error));
+    from = target;
+  }
+  int moves = sizeof(positionTargets) / sizeof(positionTargets[0]);
+  suiteSummary("position", "abs_error", errors, "%");
+  suiteResult("position", "allocations_per_move", double(simDeviceAllocations() - allocationsBefore) / moves, "count");
+
+  std::vector<double> latencies;
+  for (int i = 0; i < latencySamples; i++)
+  {
+    int target = i % 2 ? 30 : 32;
+    latencies.push_back(commandLatencyMs(positionBlind, target));
+    if (!waitStopped(positionBlind, target, 60000)) failures++;
+    sleepMs(37 * (i % 5)); // różne fazy względem okresów zadań urządzenia
+  }
+  suiteSummary("latency", "command_to_motor", latencies, "ms");
+
+  std::vector<double> stops;
+  std::vector<double> overruns; // zatrzymanie po czasie pass za krańcówką - opóźnienie ponad pass
+  for (int target : endstopTargets)
+  {
+    if (!moveBlind(endstopBlind, target, 60000)) failures++;
+    int64_t stopUs = simBlindEndstopStopUs(endstopBlind);
+    snprintf(extra, sizeof(extra), ",\"to\":%d", target);
+    if (stopUs < 0)
+    { // silnik stanął przed krańcówką - czas przejazdu z API dłuższy od rzeczywistego nie powinien się zdarzyć
+      suiteResult("endstop", "missed", 1, "count", extra);
+      failures++;
+      continue;
+    }
+    int pass = target == 0 ? simBlindSpec(endstopBlind).passUp : simBlindSpec(endstopBlind).passDown;
+    suiteResult("endstop", "endstop_to_stop", stopUs / 1000.0, "ms", extra);
+    suiteResult("endstop", "pass_overrun", stopUs / 1000.0 - pass, "ms", extra);
+    stops.push_back(stopUs / 1000.0);
+    overruns.push_back(stopUs / 1000.0 - pass);
+  }
+  suiteSummary("endstop", "endstop_to_stop", stops, "ms");
+  suiteSummary("endstop", "pass_overrun", overruns, "ms");
+
+  SimMqttStats before = simMqttStats();
+  for (int i = 0; i < messages; i++)
+  {
+    char topic[48];
+    char payload[96];
+    snprintf(topic, sizeof(topic), "ssh/blinds/set/%d", simBlindSpec(i % simBlindCount()).id);
+    snprintf(payload, sizeof(payload), "{\"id\": %d, \"set\": %d, \"speed\": 100, \"calibrate\": false}", simBlindSpec(i % simBlindCount()).id, 40 + i % 3);
+    simMqttInject(topic, payload);
+  }
+  SimMqttStats after = simMqttStats();
+  for (int waited = 0; after.messages - before.messages < (uint32_t)messages and waited < 30000; waited += 10)
+  {
+    sleepMs(10);
+    after = simMqttStats();
+  }
+  uint32_t delivered = after.messages - before.messages;
+  double seconds = (after.callbackNs - before.callbackNs) / 1e9;
+  if (delivered != (uint32_t)messages) failures++;
+  suiteResult("mqtt", "messages_per_s", delivered / max(seconds, 1e-9), "1/s");
+  suiteResult("mqtt", "callback_us", seconds * 1e6 / max(delivered, 1u), "us");
+  suiteResult("mqtt", "allocations_per_message", double(after.allocations - before.allocations) / max(delivered, 1u), "count");
+
+  suiteResult("suite", "failures", failures, "count");
+  return failures ? 1 : 0;
+}
+
+static int benchPublish()
+{ // wiadomości ssh/blinds/run/<id> na pełny przejazd rolety i pozycja w ostatniej z nich
+  // oraz seria krótkich zmian nastawienia w trakcie jazdy (starty łączone w odstępach publish_interval)
+  const int blind = 0;
+  const int targets[] = {100, 0};
+  char topic[48];
+  snprintf(topic, sizeof(topic), "ssh/blinds/run/%d", simBlindSpec(blind).id);
+
+  if (!waitReady(blind, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+  sleepMs(1000);
+
+  int result = 0;
+  for (int target : targets)
+  {
+    int from = lroundf(simBlindPosition(blind));
+    uint32_t before = simMqttPublishedCount(topic);
+    bool done = moveBlind(blind, target, 60000);
+    printf("publish move=%d->%d messages=%u final_step=%d%s\n", from, target, simMqttPublishedCount(topic) - before,
+      reportedStep(blind), done ? "" : " timeout");
+    if (!done) result = 1;
+  }
+
+  uint32_t before = simMqttPublishedCount(topic);
+  for (int i = 0; i < 10; i++)
+  {
+    sendSet(blind, 40 + i);
+    sleepMs(150);
+  }
+  bool done = waitStopped(blind, 49, 60000);
+  printf("publish retargets=10 messages=%u final_step=%d%s\n", simMqttPublishedCount(topic) - before, reportedStep(blind), done ? "" : " timeout");
+  return done ? result : 1;
+}
+
+static double messageNumber(const String& message, const char* key)
+{ // wartość liczbowa pola "key" z wiadomości JSON urządzenia, NAN gdy brak pola
+  String quoted = String("\"") + key + "\"";
+  int index = message.indexOf(quoted.c_str());
+  if (index < 0) return NAN;
+  return atof(message.c_str() + message.indexOf(':', index) + 1);
+}
+
+static int benchMotion()
+{ // wiadomości ssh/blinds/motion/<id> na pełny przejazd: zamiar jazdy przy starcie i stan końcowy,
+  // czas przejazdu zapowiedziany (duration) i zmierzony między znacznikami start i stop (z dociskiem pass za krańcówką)
+  const int blind = 0;
+  const int targets[] = {100, 0};
+  char topic[48];
+  char runTopic[48];
+  snprintf(topic, sizeof(topic), "ssh/blinds/motion/%d", simBlindSpec(blind).id);
+  snprintf(runTopic, sizeof(runTopic), "ssh/blinds/run/%d", simBlindSpec(blind).id);
+
+  if (!waitReady(blind, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+  sleepMs(1000);
+
+  int result = 0;
+  for (int target : targets)
+  {
+    int from = lroundf(simBlindPosition(blind));
+    uint32_t before = simMqttPublishedCount(topic);
+    uint32_t runBefore = simMqttPublishedCount(runTopic);
+    sendSet(blind, target);
+    String intent;
+    for (int i = 0; i < 250 and intent.indexOf("\"moving\": true") < 0; i++)
+    {
+      sleepMs(20);
+      intent = simMqttRetained(topic);
+    }
+    bool done = waitStopped(blind, target, 60000);
+    sleepMs(200);
+    String final = simMqttRetained(topic);
+    double duration = messageNumber(intent, "duration");
+    double actual = messageNumber(final, "stop") - messageNumber(intent, "start");
+    bool valid = intent.indexOf("\"moving\": true") >= 0 and final.indexOf("\"moving\": false") >= 0
+      and messageNumber(intent, "to") == target and messageNumber(final, "position") == target;
+    printf("motion move=%d->%d messages=%u run_messages=%u duration_ms=%.0f actual_ms=%.0f%s%s\n", from, target,
+      simMqttPublishedCount(topic) - before, simMqttPublishedCount(runTopic) - runBefore, duration, actual,
+      valid ? "" : " invalid", done ? "" : " timeout");
+    if (!done or !valid) result = 1;
+  }
+  return result;
+}
+
+static int benchDrift()
+{ // korekta na krańcówkach: pełne przejazdy 0 <-> 100 przy czasach przejazdu w API różnych od rzeczywistych (--runtime-error N),
+  // błąd modelu ruchu z wiadomości ruchu (drift) i błąd czasów przejazdu w API poprawianych po każdym pełnym przejeździe,
+  // na koniec błąd pozycji fizycznej po przejeździe częściowym
+  const int blind = 0;
+  const int travels = 8;
+  const int partial = 40;
+  const SimBlindSpec& spec = simBlindSpec(blind);
+  char topic[48];
+  snprintf(topic, sizeof(topic), "ssh/blinds/motion/%d", spec.id);
+
+  if (!waitReady(blind, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+  sleepMs(1000);
+
+  int result = 0;
+  for (int i = 0; i < travels; i++)
+  {
+    int target = i % 2 ? 0 : 100;
+    bool done = moveBlind(blind, target, 60000);
+    sleepMs(1500); // PATCH czasów przejazdu z apiUpdatePosition
+    int up, down;
+    simApiRuntimes(blind, &up, &down);
+    printf("drift travel=%d to=%d drift=%.2f%% runtime_up_error=%.2f%% runtime_down_error=%.2f%%%s\n", i + 1, target,
+      messageNumber(simMqttRetained(topic), "drift"), 100.0 * (up - spec.runtimeUp) / spec.runtimeUp,
+      100.0 * (down - spec.runtimeDown) / spec.runtimeDown, done ? "" : " timeout");
+    if (!done) result = 1;
+  }
+  bool done = moveBlind(blind, partial, 60000);
+  printf("drift partial=0->%d error=%.3f%%%s\n", partial, positionError(blind, partial), done ? "" : " timeout");
+  if (!done) result = 1;
+  return result;
+}
+
+static int benchJitter()
+{ // stabilność ticków silnika ruchu (rdzeń aplikacyjny) przy pracy rolet 0 i 1 bez ruchu sieciowego i przy zalewie API:
+  // krótkie przejazdy rolet 2 i 3 (PATCH pozycji po każdym zatrzymaniu) i wątki obciążające procesor rdzenia sieciowego
+  const char* phases[] = {"quiet", "api"};
+  const int netCore = 0;
+  const int loadThreads = 2;
+
+  if (!waitReady(3, 30000))
+  {
+    printf("device not ready\n");
+    return 1;
+  }
+  sleepMs(1000);
+
+  int result = 0;
+  for (int phase = 0; phase < 2; phase++)
+  {
+    String metrics;
+    uint32_t periodBefore[16], periodAfter[16], jitterBefore[16], jitterAfter[16];
+    if (!requestMetrics(&metrics) or !metricsHistogram(metrics, "motion", "period", periodBefore)
+      or !metricsHistogram(metrics, "motion", "jitter", jitterBefore))
+    {
+      printf("metrics not published\n");
+      return 1;
+    }
+    SimHttpStats http = simHttpStats();
+    CpuLoad load;
+    if (phase == 1) load.start(loadThreads, netCore);
+
+    int target = reportedStep(0) < 50 ? 100 : 0;
+    sendSet(0, target);
+    sendSet(1, target);
+    sleepMs(300);
+    for (int bounce = 0; simBlindMoving(0) or simBlindMoving(1); bounce++)
+    {
+      if (phase == 1)
+      {
+        sendSet(2, 40 + 4 * (bounce % 2));
+        sendSet(3, 40 + 4 * (bounce % 2));
+      }
+      sleepMs(600);
+    }
+    bool done = waitStopped(0, target, 30000) and waitStopped(1, target, 30000);
+    if (phase == 1) load.stop();
+    sleepMs(1500); // ostatni PATCH z apiUpdatePosition
+
+    if (!requestMetrics(&metrics) or !metricsHistogram(metrics, "motion", "period", periodAfter)
+      or !metricsHistogram(metrics, "motion", "jitter", jitterAfter))
+    {
+      printf("metrics not published\n");
+      return 1;
+    }
+    uint32_t ticks = 0;
+    uint32_t late = 0; // ticki spóźnione o 1 ms i więcej
+    for (int i = 0; i < 16; i++)
+    {
+      ticks += jitterAfter[i] - jitterBefore[i];
+      if (i >= 5) late += jitterAfter[i] - jitterBefore[i];
+    }
+    printf("jitter phase=%s ticks=%u http_requests=%u period_p50_us<=%u period_p99_us<=%u jitter_p50_us<=%u jitter_p99_us<=%u late_1ms=%u%s\n",
+      phases[phase], ticks, simHttpStats().requests - http.requests,
+      histogramPercentile(periodBefore, periodAfter, 50), histogramPercentile(periodBefore, periodAfter, 99),
+      histogramPercentile(jitterBefore, jitterAfter, 50), histogramPercentile(jitterBefore, jitterAfter, 99), late, done ? "" : " timeout");
+    if (!done) result = 1;
+  }
+  return result;
+}
+
+int simBench(const char* name)
+{
+  if (strcmp(name, "position") == 0) return benchPosition();
+  if (strcmp(name, "latency") == 0) return benchLatency();
+  if (strcmp(name, "http") == 0) return benchHttp();
+  if (strcmp(name, "outage") == 0) return benchOutage();
+  if (strcmp(name, "parser") == 0) return benchParser();
+  if (strcmp(name, "soak") == 0) return benchSoak();
+  if (strcmp(name, "telemetry") == 0) return benchTelemetry();
+  if (strcmp(name, "boot") == 0) return benchBoot();
+  if (strcmp(name, "group") == 0) return benchGroup();
+  if (strcmp(name, "scale") == 0) return benchScale();
+  if (strcmp(name, "metrics") == 0) return benchMetrics();
+  if (strcmp(name, "suite") == 0) return benchSuite();
+  if (strcmp(name, "jitter") == 0) return benchJitter();
+  if (strcmp(name, "publish") == 0) return benchPublish();
+  if (strcmp(name, "motion") == 0) return benchMotion();
+  if (strcmp(name, "speed") == 0) return benchSpeed();
+  if (strcmp(name, "drift") == 0) return benchDrift();
+  if (strcmp(name, "powercut") == 0) return benchPowercut();
+  if (strcmp(name, "powercut-round") == 0) return benchPowercutRound();
+  printf("unknown benchmark: %s\n", name);
+  return 2;
+}
@@ -0,0 +1,10 @@
+#ifndef SIM_ESP_TIMER_H
+#define SIM_ESP_TIMER_H
+
+#include <stdint.h>
+
+// podzbiór API esp_timer (ESP-IDF) - tylko zegar w us (Arduino.cpp)
+
+int64_t esp_timer_get_time();
+
+#endif
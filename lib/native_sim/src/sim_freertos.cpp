@@ -0,0 +1,218 @@
+#include "sim_freertos.h"
+#include "sim.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// stos zadania we własnym obszarze wypełnionym wzorcem - zużycie stosu jak w FreeRTOS (uxTaskGetStackHighWaterMark)
+// host x86-64/glibc zużywa kilka razy więcej stosu niż Xtensa (wskaźniki 8 B, printf glibc) - zadanie ma w symulacji
+// Sim_Stack_Scale razy większy budżet, wolny stos raportowany w skali urządzenia (wartości orientacyjne)
+static const size_t Sim_Task_Stack_Size = 1 << 20;
+static const size_t Sim_Stack_Scale = 4;
+static const uint8_t Sim_Stack_Pattern = 0xa5;
+
+struct SimTask
+{
+  std::string name;
+  UBaseType_t priority;
+  uint32_t stackDepth = 0; // rozmiar stosu podany przy tworzeniu w bajtach
+  uint8_t* stack = NULL;
+  TaskFunction_t code = NULL;
+  void* parameters = NULL;
+  BaseType_t core = tskNO_AFFINITY;
+  std::mutex lock;
+  std::condition_variable notified;
+  uint32_t notifyValue = 0;
+};
+
+static thread_local SimTask* Current_Task = NULL;
+static std::mutex Tasks_Lock;
+static std::vector<SimTask*> Tasks;
+
+static cpu_set_t currentCpus()
+{
+  cpu_set_t cpus;
+  sched_getaffinity(0, sizeof(cpus), &cpus);
+  return cpus;
+}
+
+static const cpu_set_t& processCpus()
+{ // procesory hosta dostępne dla procesu (--cpus) - odczyt z wątku głównego przy tworzeniu pierwszego zadania
+  static const cpu_set_t cpus = currentCpus();
+  return cpus;
+}
+
+void simPinThreadToCore(int core)
+{ // rdzeń N urządzenia = N-ty procesor procesu, bez przypięcia przy jednym procesorze
+  // wątek bez przypięcia dostaje wszystkie procesory procesu (zadanie tworzone z zadania przypiętego dziedziczy jego maskę)
+  const cpu_set_t& cpus = processCpus();
+  cpu_set_t pinned = cpus;
+  if (core != tskNO_AFFINITY and simPinning() and CPU_COUNT(&cpus) > 1)
+  {
+    CPU_ZERO(&pinned);
+    for (int cpu = 0, seen = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+      if (CPU_ISSET(cpu, &cpus) and seen++ == core)
+      {
+        CPU_SET(cpu, &pinned);
+        break;
+      }
+    }
+    if (CPU_COUNT(&pinned) == 0) pinned = cpus;
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned);
+}
+
+static void* taskEntry(void* argument)
+{
+  SimTask* task = static_cast<SimTask*>(argument);
+  Current_Task = task;
+  simMarkDeviceThread();
+  simPinThreadToCore(task->core);
+  pthread_setname_np(pthread_self(), task->name.substr(0, 15).c_str());
+  task->code(task->parameters);
+  return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth, void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pxCreatedTask)
+{
+  return xTaskCreatePinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask, tskNO_AFFINITY);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth, void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pxCreatedTask, BaseType_t xCoreID)
+{
+  processCpus();
+  SimTask* task = new SimTask;
+  task->name = pcName ? pcName : "";
+  task->priority = uxPriority;
+  task->stackDepth = usStackDepth;
+  task->code = pvTaskCode;
+  task->parameters = pvParameters;
+  task->core = xCoreID;
+  void* stack = mmap(NULL, Sim_Task_Stack_Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0); // poza stertą urządzenia (sim_alloc.cpp)
+  if (stack == MAP_FAILED) return pdFAIL;
+  task->stack = static_cast<uint8_t*>(stack);
+  memset(task->stack, Sim_Stack_Pattern, Sim_Task_Stack_Size);
+  {
+    std::lock_guard<std::mutex> guard(Tasks_Lock);
+    Tasks.push_back(task);
+  }
+  if (pxCreatedTask) *pxCreatedTask = task;
+
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  pthread_attr_setstack(&attributes, task->stack, Sim_Task_Stack_Size);
+  pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+  pthread_t thread;
+  int error = pthread_create(&thread, &attributes, taskEntry, task);
+  pthread_attr_destroy(&attributes);
+  return error == 0 ? pdPASS : pdFAIL;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+{ // najmniejszy wolny stos od startu zadania w bajtach - część obszaru z nienaruszonym wzorcem
+  if (xTask == NULL) xTask = xTaskGetCurrentTaskHandle();
+  if (xTask->stack == NULL) return 0;
+  const volatile uint8_t* stack = xTask->stack;
+  size_t untouched = 0;
+  while (untouched < Sim_Task_Stack_Size and stack[untouched] == Sim_Stack_Pattern) untouched++;
+  size_t used = Sim_Task_Stack_Size - untouched;
+  size_t budget = xTask->stackDepth * Sim_Stack_Scale;
+  return used < budget ? (budget - used) / Sim_Stack_Scale : 0;
+}
+
+TaskHandle_t xTaskGetHandle(const char* pcNameToQuery)
+{
+  std::lock_guard<std::mutex> guard(Tasks_Lock);
+  for (SimTask* task : Tasks)
+  {
+    if (task->name == pcNameToQuery) return task;
+  }
+  return NULL;
+}
+
+void vTaskDelete(TaskHandle_t xTask)
+{
+  // na hoście można usunąć tylko bieżące zadanie
+  if (xTask == NULL or xTask == Current_Task)
+  {
+    pthread_exit(NULL);
+  }
+}
+
+static int64_t tickDeadlineUs(TickType_t ticks)
+{ // jak w FreeRTOS: oczekiwanie kończy się na granicy ticku - N ticków trwa od N-1 do N ms
+  return (simMicros() / 1000 + ticks) * 1000LL;
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+  simSleepUs(tickDeadlineUs(xTicksToDelay) - simMicros());
+}
+
+TickType_t xTaskGetTickCount()
+{
+  return simMicros() / 1000;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+  if (Current_Task == NULL)
+  {
+    Current_Task = new SimTask;
+    Current_Task->name = "main";
+    Current_Task->priority = 1;
+  }
+  return Current_Task;
+}
+
+const char* pcTaskGetName(TaskHandle_t xTask)
+{
+  if (xTask == NULL) xTask = xTaskGetCurrentTaskHandle();
+  return xTask->name.c_str();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+  {
+    std::lock_guard<std::mutex> guard(xTaskToNotify->lock);
+    xTaskToNotify->notifyValue++;
+  }
+  xTaskToNotify->notified.notify_one();
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t* pxHigherPriorityTaskWoken)
+{
+  xTaskNotifyGive(xTaskToNotify);
+  if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+  SimTask* task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> guard(task->lock);
+  auto pending = [task]() { return task->notifyValue > 0; };
+  if (xTicksToWait == portMAX_DELAY)
+  {
+    task->notified.wait(guard, pending);
+  }
+  else
+  {
+    task->notified.wait_for(guard, std::chrono::microseconds(simRealUs(tickDeadlineUs(xTicksToWait) - simMicros())), pending);
+  }
+
+  uint32_t value = task->notifyValue;
+  if (value > 0)
+  {
+    task->notifyValue = xClearCountOnExit ? 0 : value - 1;
+  }
+  return value;
+}
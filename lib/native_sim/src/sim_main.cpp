@@ -0,0 +1,33 @@
+#include "Arduino.h"
+#include "sim.h"
+
+#include <unistd.h>
+
+// punkt wejścia na hoście - odpowiednik loopTask z rdzenia Arduino-ESP32
+
+static void loopTask(void* parameters)
+{
+  setup();
+  while (true)
+  {
+    loop();
+  }
+}
+
+int main(int argc, char** argv)
+{
+  simBegin(argc, argv);
+  xTaskCreate(loopTask, "loopTask", CONFIG_ARDUINO_LOOP_STACK_SIZE, NULL, 1, NULL);
+
+  int result = 0;
+  if (simBenchName())
+  {
+    result = simBench(simBenchName());
+  }
+  else
+  {
+    simWait();
+  }
+  fflush(stdout);
+  _exit(result);
+}
@@ -0,0 +1,445 @@
+#ifdef ARDUINO
+
+#include "hal.h"
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include <HTTPClient.h>
+#include <Wire.h>
+#include <Adafruit_MCP23X17.h>
+#include <OneWire.h>
+#include <DallasTemperature.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+#include <esp_partition.h>
+#include <esp_freertos_hooks.h>
+#include <esp_arduino_version.h>
+
+#define I2C_SDA_PIN 21
+#define I2C_SCL_PIN 22
+#define ONE_WIRE_PIN 15
+#define MCP_INT_PIN 27 // INTA i INTB wszystkich MCP23017 (zmostkowane w rejestrze IOCON, wyjścia open-drain)
+
+static Adafruit_MCP23X17 mcp[8]; // układy 0x20..0x27
+static bool Mcp_Isr_Attached = false;
+static WiFiClient wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static OneWire oneWire(ONE_WIRE_PIN);
+static DallasTemperature sensors(&oneWire);
+static Preferences preferences;
+static volatile uint32_t Mcp_Transactions = 0;
+static WiFiClient httpTransport; // trwałe połączenie z API (HTTP/1.1 keep-alive)
+static HTTPClient httpClient;
+static SemaphoreHandle_t Http_Lock = NULL; // kolejka żądań HTTP z wielu zadań
+static String Http_Token; // token, dla którego zbudowano nagłówek
+static String Http_Authorization; // nagłówek Authorization budowany raz na token
+static uint32_t Http_Connections = 0;
+static SemaphoreHandle_t Mqtt_Lock = NULL; // PubSubClient nie jest wielowątkowy - publikacje z wielu zadań
+static const uint8_t Temp_Sensors_Max = 8;
+static DeviceAddress Temp_Address[Temp_Sensors_Max]; // adresy czujników - odczyt bez wyszukiwania na magistrali
+static uint8_t Temp_Count = 0;
+static uint32_t Speed_Frequency = 1000;
+static uint8_t Speed_Resolution = 10;
+static int8_t Speed_Channel[40]; // kanał LEDC pinu prędkości, -1 = pin bez kanału
+static uint8_t Speed_Channels = 0;
+static const uint8_t Speed_Channels_Max = 16;
+static const esp_partition_t* Journal_Partition = NULL; // partycja spiffs z domyślnej tablicy partycji - projekt nie używa SPIFFS
+static const uint32_t Journal_Size = 65536; // dziennik zajmuje początek partycji (16 sektorów)
+static const uint32_t Journal_Sector_Size = 4096; // sektor kasowania flash SPI
+static volatile uint32_t Cpu_Ticks[portNUM_PROCESSORS] = {};
+static volatile uint32_t Cpu_Idle_Ticks[portNUM_PROCESSORS] = {};
+static uint32_t Cpu_Ticks_Read[portNUM_PROCESSORS] = {}; // liczniki z poprzedniego halCpuLoad
+static uint32_t Cpu_Idle_Ticks_Read[portNUM_PROCESSORS] = {};
+
+class MqttGuard
+{ // blokada rekurencyjna - callback wywoływany z halMqttLoop może publikować
+public:
+  MqttGuard() { if (Mqtt_Lock) xSemaphoreTakeRecursive(Mqtt_Lock, portMAX_DELAY); }
+  ~MqttGuard() { if (Mqtt_Lock) xSemaphoreGiveRecursive(Mqtt_Lock); }
+};
+
+bool halMcpBegin(uint8_t chip)
+{
+  Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN); // ponowne wywołanie dla kolejnego układu nie zmienia magistrali
+  return mcp[chip].begin_I2C(MCP23XXX_ADDR + chip);
+}
+
+void halMcpPinMode(uint8_t chip, uint8_t pin, uint8_t mode)
+{
+  Mcp_Transactions += 4; // odczyt-modyfikacja-zapis IODIR i GPPU
+  mcp[chip].pinMode(pin, mode);
+}
+
+uint8_t halMcpDigitalRead(uint8_t chip, uint8_t pin)
+{
+  Mcp_Transactions += 1;
+  return mcp[chip].digitalRead(pin);
+}
+
+void halMcpDigitalWrite(uint8_t chip, uint8_t pin, uint8_t value)
+{
+  Mcp_Transactions += 2; // odczyt-modyfikacja-zapis GPIO
+  mcp[chip].digitalWrite(pin, value);
+}
+
+uint16_t halMcpReadGPIOAB(uint8_t chip)
+{
+  Mcp_Transactions += 1;
+  return mcp[chip].readGPIOAB();
+}
+
+void halMcpWriteGPIOAB(uint8_t chip, uint16_t value)
+{
+  Mcp_Transactions += 1;
+  mcp[chip].writeGPIOAB(value);
+}
+
+uint32_t halMcpTransactions()
+{
+  return Mcp_Transactions;
+}
+
+void halMcpSetupInterrupts(uint8_t chip, uint16_t pins, void (*isr)())
+{
+  Mcp_Transactions += 2;
+  mcp[chip].setupInterrupts(true, true, LOW); // INTA = INTB, open-drain - wspólna linia układów, aktywne stanem niskim
+  for (uint8_t pin = 0; pin < 16; pin++)
+  {
+    if (pins & (1 << pin))
+    {
+      Mcp_Transactions += 4;
+      mcp[chip].setupInterruptPin(pin, CHANGE);
+    }
+  }
+  Mcp_Transactions += 1;
+  mcp[chip].readGPIOAB(); // skasowanie przerwania zgłoszonego przed podpięciem ISR
+
+  if (!Mcp_Isr_Attached)
+  { // linia trzymana w stanie niskim do odczytu wszystkich układów, które zgłosiły przerwanie
+    pinMode(MCP_INT_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(MCP_INT_PIN), isr, FALLING);
+    Mcp_Isr_Attached = true;
+  }
+}
+
+void halSpeedBegin(uint32_t frequency, uint8_t resolution)
+{
+  Speed_Frequency = frequency;
+  Speed_Resolution = resolution;
+  memset(Speed_Channel, -1, sizeof(Speed_Channel));
+}
+
+bool halSpeedPinValid(int pin)
+{ // GPIO34-39 tylko wejścia, GPIO6-11 flash SPI, GPIO1 i 3 UART0 (Serial), GPIO20, 24 i 28-31 nie istnieją
+  if (pin < 0 or pin > 33 or pin == 1 or pin == 3 or (pin >= 6 and pin <= 11) or pin == 20 or pin == 24 or (pin >= 28 and pin <= 31)) return false;
+  return pin != I2C_SDA_PIN and pin != I2C_SCL_PIN and pin != ONE_WIRE_PIN and pin != MCP_INT_PIN;
+}
+
+bool halSpeedPinInit(uint8_t pin)
+{
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+  if (pin >= sizeof(Speed_Channel) or Speed_Channels == Speed_Channels_Max) return false; // silnik bez PWM stoi
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+  if (!ledcAttach(pin, Speed_Frequency, Speed_Resolution)) return false;
+#else
+  if (ledcSetup(Speed_Channels, Speed_Frequency, Speed_Resolution) == 0) return false;
+  ledcAttachPin(pin, Speed_Channels);
+#endif
+  Speed_Channel[pin] = Speed_Channels++;
+  return true;
+}
+
+void halSpeedWrite(uint8_t pin, float duty)
+{
+  if (pin >= sizeof(Speed_Channel) or Speed_Channel[pin] < 0) return;
+  uint32_t top = (1u << Speed_Resolution) - 1;
+  uint32_t value = duty <= 0 ? 0 : duty >= 1 ? top : uint32_t(lroundf(duty * top));
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+  ledcWrite(pin, value);
+#else
+  ledcWrite(Speed_Channel[pin], value);
+#endif
+}
+
+void halWiFiBegin(const String& hostname, const char* ssid, const char* password)
+{
+  if (Http_Lock == NULL) Http_Lock = xSemaphoreCreateMutex(); // pierwsze wywołanie w setup(), przed zadaniami API
+  WiFi.hostname(hostname);
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(ssid, password);
+}
+
+bool halWiFiConnected()
+{
+  return WiFi.status() == WL_CONNECTED;
+}
+
+int halWiFiStatus()
+{
+  return WiFi.status();
+}
+
+String halWiFiIP()
+{
+  return WiFi.localIP().toString();
+}
+
+String halWiFiSSID()
+{
+  return WiFi.SSID();
+}
+
+String halWiFiMac()
+{
+  return WiFi.macAddress();
+}
+
+long halWiFiRSSI()
+{
+  return WiFi.RSSI();
+}
+
+static int httpSend(const char* method, const char* url, const char* payload, const String& token, String* response)
+{
+  httpClient.begin(httpTransport, url); // przy otwartym połączeniu HTTPClient::connect() używa go ponownie (jeden host API)
+  httpClient.setReuse(true);
+  httpClient.addHeader("Content-Type", "application/json");
+  if (token.length() > 0)
+  {
+    if (token != Http_Token)
+    {
+      Http_Token = token;
+      Http_Authorization = "Bearer " + token;
+    }
+    httpClient.addHeader("Authorization", Http_Authorization);
+  }
+  int httpResponseCode = httpClient.sendRequest(method, (uint8_t*)payload, strlen(payload));
+
+  if (httpResponseCode > 0 and response != NULL)
+  {
+    *response = httpClient.getString();
+  }
+  httpClient.end(); // przy keep-alive połączenie pozostaje otwarte
+  return httpResponseCode;
+}
+
+int halHttpRequest(const char* method, const char* url, const char* payload, const String& token, String* response)
+{
+  xSemaphoreTake(Http_Lock, portMAX_DELAY);
+  bool reused = httpTransport.connected();
+  if (!reused) Http_Connections++;
+  int httpResponseCode = httpSend(method, url, payload, token, response);
+  if (httpResponseCode < 0 and reused)
+  { // serwer mógł zamknąć bezczynne połączenie - jedna ponowna próba na nowym
+    httpTransport.stop();
+    Http_Connections++;
+    httpResponseCode = httpSend(method, url, payload, token, response);
+  }
+  xSemaphoreGive(Http_Lock);
+  return httpResponseCode;
+}
+
+uint32_t halHttpConnections()
+{
+  return Http_Connections;
+}
+
+void halMqttSetup(const char* server, int port, HalMqttCallback callback, int bufferSize)
+{
+  if (Mqtt_Lock == NULL) Mqtt_Lock = xSemaphoreCreateRecursiveMutex();
+  MqttGuard guard;
+  mqttClient.setServer(server, port);
+  mqttClient.setCallback(callback);
+  mqttClient.setBufferSize(bufferSize);
+}
+
+bool halMqttConnect(const char* id, const char* user, const char* password, const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage)
+{
+  MqttGuard guard;
+  return mqttClient.connect(id, user, password, willTopic, willQos, willRetain, willMessage);
+}
+
+bool halMqttConnected()
+{
+  MqttGuard guard;
+  return mqttClient.connected();
+}
+
+int halMqttState()
+{
+  MqttGuard guard;
+  return mqttClient.state();
+}
+
+bool halMqttSubscribe(const char* topic)
+{
+  MqttGuard guard;
+  return mqttClient.subscribe(topic);
+}
+
+bool halMqttPublish(const char* topic, const char* payload, bool retained)
+{ // bufor klienta mieści wiadomości przychodzące - dłuższa publikacja (metryki) z bufora wywołującego bez kopiowania
+  MqttGuard guard;
+  size_t length = strlen(payload);
+  if (MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + length <= mqttClient.getBufferSize())
+  {
+    return mqttClient.publish(topic, payload, retained);
+  }
+  return mqttClient.beginPublish(topic, length, retained)
+    and mqttClient.write((const uint8_t*)payload, length) == length
+    and mqttClient.endPublish();
+}
+
+void halMqttLoop()
+{
+  MqttGuard guard;
+  mqttClient.loop();
+}
+
+bool halMqttWait(uint32_t timeoutMs)
+{ // select() na gnieździe klienta - blokada zwolniona, więc inne zadania mogą w tym czasie publikować
+  int fd;
+  {
+    MqttGuard guard;
+    if (wifiClient.available()) return true; // PubSubClient czyta jeden pakiet na loop(), reszta czeka w buforze
+    fd = wifiClient.connected() ? wifiClient.fd() : -1;
+  }
+  if (fd < 0)
+  {
+    vTaskDelay(pdMS_TO_TICKS(timeoutMs));
+    return false;
+  }
+  fd_set readable;
+  FD_ZERO(&readable);
+  FD_SET(fd, &readable);
+  struct timeval timeout = {(time_t)(timeoutMs / 1000), (suseconds_t)((timeoutMs % 1000) * 1000)};
+  return select(fd + 1, &readable, NULL, NULL, &timeout) > 0;
+}
+
+void halNvsBegin()
+{
+  preferences.begin("ssh", false);
+}
+
+bool halNvsGetInt(const char* key, int32_t* value)
+{
+  if (!preferences.isKey(key)) return false;
+  *value = preferences.getInt(key);
+  return true;
+}
+
+void halNvsSetInt(const char* key, int32_t value)
+{
+  preferences.putInt(key, value);
+}
+
+bool halNvsGetString(const char* key, char* value, size_t size)
+{
+  if (!preferences.isKey(key)) return false;
+  return preferences.getString(key, value, size) > 0;
+}
+
+void halNvsSetString(const char* key, const char* value)
+{
+  preferences.putString(key, value);
+}
+
+void halNvsRemove(const char* key)
+{
+  preferences.remove(key);
+}
+
+uint32_t halJournalBegin()
+{
+  Journal_Partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
+  if (Journal_Partition == NULL) return 0;
+  return Journal_Partition->size < Journal_Size ? Journal_Partition->size / Journal_Sector_Size * Journal_Sector_Size : Journal_Size;
+}
+
+uint32_t halJournalSectorSize()
+{
+  return Journal_Sector_Size;
+}
+
+bool halJournalRead(uint32_t offset, void* data, size_t size)
+{
+  return esp_partition_read(Journal_Partition, offset, data, size) == ESP_OK;
+}
+
+bool halJournalWrite(uint32_t offset, const void* data, size_t size)
+{
+  return esp_partition_write(Journal_Partition, offset, data, size) == ESP_OK;
+}
+
+bool halJournalErase(uint32_t sector)
+{
+  return esp_partition_erase_range(Journal_Partition, sector * Journal_Sector_Size, Journal_Sector_Size) == ESP_OK;
+}
+
+uint32_t halHeapFree()
+{
+  return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+}
+
+uint32_t halHeapLargestFreeBlock()
+{
+  return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
+
+static void IRAM_ATTR cpuTick()
+{ // hook ticka wywoływany na każdym rdzeniu osobno
+  BaseType_t core = xPortGetCoreID();
+  Cpu_Ticks[core]++;
+  if (xTaskGetCurrentTaskHandleForCPU(core) == xTaskGetIdleTaskHandleForCPU(core)) Cpu_Idle_Ticks[core]++;
+}
+
+void halCpuLoadBegin()
+{
+  for (int core = 0; core < portNUM_PROCESSORS; core++)
+  {
+    esp_register_freertos_tick_hook_for_cpu(cpuTick, core);
+  }
+}
+
+float halCpuLoad(uint8_t core)
+{
+  if (core >= portNUM_PROCESSORS) return 0;
+  uint32_t ticks = Cpu_Ticks[core];
+  uint32_t idle = Cpu_Idle_Ticks[core];
+  uint32_t elapsed = ticks - Cpu_Ticks_Read[core];
+  uint32_t idleElapsed = idle - Cpu_Idle_Ticks_Read[core];
+  Cpu_Ticks_Read[core] = ticks;
+  Cpu_Idle_Ticks_Read[core] = idle;
+  return elapsed > 0 ? 100.0f * (elapsed - idleElapsed) / elapsed : 0;
+}
+
+uint8_t halTempBegin(uint8_t resolution)
+{
+  sensors.begin();
+  sensors.setResolution(resolution);
+  sensors.setWaitForConversion(false); // requestTemperatures() wraca od razu po rozkazie konwersji
+  Temp_Count = 0;
+  for (uint8_t i = 0; i < sensors.getDeviceCount() and Temp_Count < Temp_Sensors_Max; i++)
+  {
+    if (sensors.getAddress(Temp_Address[Temp_Count], i)) Temp_Count++;
+  }
+  return Temp_Count;
+}
+
+void halTempRequest()
+{
+  sensors.requestTemperatures();
+}
+
+bool halTempReady()
+{
+  return sensors.isConversionComplete();
+}
+
+float halTempC(uint8_t index)
+{
+  if (index >= Temp_Count) return DEVICE_DISCONNECTED_C;
+  return sensors.getTempC(Temp_Address[index]);
+}
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef ARDUINO
+
+#include "hal.h"
+#include "sim.h"
+
+#include <mutex>
+
+static HalMqttCallback Mqtt_Callback = NULL;
+static volatile uint32_t Mcp_Transactions = 0;
+static std::mutex Http_Lock;
+static uint8_t Speed_Resolution = 10; // rozdzielczość PWM LEDC - wypełnienie w symulacji skwantowane jak na ESP32
+
+bool halMcpBegin(uint8_t chip)
+{
+  return simMcpBegin(chip);
+}
+
+void halMcpPinMode(uint8_t chip, uint8_t pin, uint8_t mode)
+{
+  Mcp_Transactions += 4;
+  simMcpPinMode(chip, pin, mode);
+}
+
+uint8_t halMcpDigitalRead(uint8_t chip, uint8_t pin)
+{
+  Mcp_Transactions += 1;
+  return simMcpDigitalRead(chip, pin);
+}
+
+void halMcpDigitalWrite(uint8_t chip, uint8_t pin, uint8_t value)
+{
+  Mcp_Transactions += 2;
+  simMcpDigitalWrite(chip, pin, value);
+}
+
+uint16_t halMcpReadGPIOAB(uint8_t chip)
+{
+  Mcp_Transactions += 1;
+  return simMcpReadGPIOAB(chip);
+}
+
+void halMcpWriteGPIOAB(uint8_t chip, uint16_t value)
+{
+  Mcp_Transactions += 1;
+  simMcpWriteGPIOAB(chip, value);
+}
+
+uint32_t halMcpTransactions()
+{
+  return Mcp_Transactions;
+}
+
+void halMcpSetupInterrupts(uint8_t chip, uint16_t pins, void (*isr)())
+{
+  Mcp_Transactions += 2 + 4 * __builtin_popcount(pins) + 1;
+  simMcpSetupInterrupts(chip, pins, isr);
+}
+
+void halSpeedBegin(uint32_t frequency, uint8_t resolution)
+{
+  Speed_Resolution = resolution;
+}
+
+bool halSpeedPinValid(int pin)
+{ // jak na płytce produkcyjnej (src/hal_esp32.cpp) - to samo okablowanie przechodzi walidację w symulacji i na ESP32
+  if (pin < 0 or pin > 33 or pin == 1 or pin == 3 or (pin >= 6 and pin <= 11) or pin == 20 or pin == 24 or (pin >= 28 and pin <= 31)) return false;
+  return pin != 21 and pin != 22 and pin != 15 and pin != 27; // I2C SDA i SCL, 1-Wire, przerwanie MCP
+}
+
+bool halSpeedPinInit(uint8_t pin)
+{
+  simPwmWrite(pin, 0);
+  return true;
+}
+
+void halSpeedWrite(uint8_t pin, float duty)
+{ // wypełnienie w rozdzielczości kanału LEDC
+  uint32_t top = (1u << Speed_Resolution) - 1;
+  uint32_t value = duty <= 0 ? 0 : duty >= 1 ? top : uint32_t(lroundf(duty * top));
+  simPwmWrite(pin, float(value) / top);
+}
+
+void halWiFiBegin(const String& hostname, const char* ssid, const char* password)
+{
+  simWiFiBegin();
+}
+
+bool halWiFiConnected()
+{
+  return simWiFiConnected();
+}
+
+int halWiFiStatus()
+{
+  return halWiFiConnected() ? 3 : 6; // WL_CONNECTED : WL_DISCONNECTED
+}
+
+String halWiFiIP()
+{
+  return "127.0.0.1";
+}
+
+String halWiFiSSID()
+{
+  return "simulator";
+}
+
+String halWiFiMac()
+{
+  return "02:00:00:00:00:01";
+}
+
+long halWiFiRSSI()
+{
+  return -55;
+}
+
+int halHttpRequest(const char* method, const char* url, const char* payload, const String& token, String* response)
+{
+  if (!halWiFiConnected()) return -1; // HTTPC_ERROR_CONNECTION_REFUSED
+  std::lock_guard<std::mutex> guard(Http_Lock);
+  return simHttpRequest(method, url, payload, token, response, true);
+}
+
+uint32_t halHttpConnections()
+{
+  return simHttpStats().connections;
+}
+
+void halMqttSetup(const char* server, int port, HalMqttCallback callback, int bufferSize)
+{
+  Mqtt_Callback = callback;
+  simMqttSetup(server, port, bufferSize);
+}
+
+bool halMqttConnect(const char* id, const char* user, const char* password, const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage)
+{
+  return halWiFiConnected() and simMqttConnect(id, willTopic, willMessage);
+}
+
+bool halMqttConnected()
+{
+  return simMqttConnected();
+}
+
+int halMqttState()
+{
+  return simMqttConnected() ? 0 : -1; // MQTT_CONNECTED : MQTT_DISCONNECTED
+}
+
+bool halMqttSubscribe(const char* topic)
+{
+  return simMqttSubscribe(topic);
+}
+
+bool halMqttPublish(const char* topic, const char* payload, bool retained)
+{
+  return simMqttPublish(topic, payload, retained);
+}
+
+void halMqttLoop()
+{
+  simMqttLoop(Mqtt_Callback);
+}
+
+bool halMqttWait(uint32_t timeoutMs)
+{
+  return simMqttWait(timeoutMs);
+}
+
+void halNvsBegin()
+{
+}
+
+bool halNvsGetInt(const char* key, int32_t* value)
+{
+  return simNvsGet(key, value);
+}
+
+void halNvsSetInt(const char* key, int32_t value)
+{
+  simNvsSet(key, value);
+}
+
+bool halNvsGetString(const char* key, char* value, size_t size)
+{
+  return simNvsGetString(key, value, size);
+}
+
+void halNvsSetString(const char* key, const char* value)
+{
+  simNvsSetString(key, value);
+}
+
+void halNvsRemove(const char* key)
+{
+  simNvsRemove(key);
+}
+
+uint32_t halJournalBegin()
+{
+  return simJournalSize();
+}
+
+uint32_t halJournalSectorSize()
+{
+  return simJournalSectorSize();
+}
+
+bool halJournalRead(uint32_t offset, void* data, size_t size)
+{
+  return simJournalRead(offset, data, size);
+}
+
+bool halJournalWrite(uint32_t offset, const void* data, size_t size)
+{
+  return simJournalWrite(offset, data, size);
+}
+
+bool halJournalErase(uint32_t sector)
+{
+  return simJournalErase(sector);
+}
+
+uint32_t halHeapFree()
+{
+  return simHeapFree();
+}
+
+uint32_t halHeapLargestFreeBlock()
+{
+  return simHeapLargestFreeBlock();
+}
+
+void halCpuLoadBegin()
+{
+  simCpuLoad(); // początek pierwszego okresu pomiaru
+}
+
+float halCpuLoad(uint8_t core)
+{ // host nie rozróżnia rdzeni - obciążenie procesu na obu rdzeniach, okres pomiaru liczony od wywołania dla rdzenia 0
+  static float load = 0;
+  if (core == 0) load = simCpuLoad();
+  return load;
+}
+
+uint8_t halTempBegin(uint8_t resolution)
+{
+  simTempSetResolution(resolution);
+  return simTempCount();
+}
+
+void halTempRequest()
+{
+  simTempRequest();
+}
+
+bool halTempReady()
+{
+  return simTempReady();
+}
+
+float halTempC(uint8_t index)
+{
+  return index < simTempCount() ? simTempC(index) : -127; // DEVICE_DISCONNECTED_C
+}
+
+#endif
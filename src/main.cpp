@@ -1,74 +1,318 @@
 #include "Arduino.h"
 #include "time.h"
-#include <WiFi.h>
-#include <PubSubClient.h>
+#include <sys/time.h>
 #include <ArduinoJson.h>  // https://arduinojson.org/v7/assistant/#/step1
-#include <HTTPClient.h>
-#include <Wire.h>
-#include <Adafruit_MCP23X17.h>
-#include <OneWire.h>
-#include <DallasTemperature.h>
+#include "hal.h"
+#include "seqlock.h"
+#include "static_allocator.h"
+#include "flash_journal.h"
+#include "metrics.h"
+#include "event_queue.h"
 #include "config.h"
 
 #define BUILT_LED 2
 
-Adafruit_MCP23X17 mcp;
-
 int Boot_Timestamp = 0; //czas uruchomienia (uniksowy)
+int32_t Boot_Ready_Ms = -1; //czas od włączenia do gotowości (silnik ruchu i subskrypcja MQTT) w ms
+const int32_t Boot_Cache_Version = 1; //wersja konfiguracji i stanu rolet zapisanych w NVS (klucz "cache")
+std::atomic<bool> Api_Synced{false}; //dane rolet pobrane z API - od tej chwili apiUpdatePosition wysyła pozycje
 
 String accessToken;
 String refreshToken;
 
-String WiFi_IP = ""; //WiFi IP uzupełniane po nawiązaniu połączenia
+char WiFi_IP[16] = ""; //WiFi IP uzupełniane po nawiązaniu połączenia
+char WiFi_SSID[33] = ""; //SSID sieci, do której podłączone jest urządzenie
+char WiFi_Mac[18] = ""; //adres MAC interfejsu WiFi
 
 String Mqtt_Server; //MQTT broker address
 int Mqtt_Port; //MQTT broker port
 String Mqtt_User; //MQTT broker username
 String Mqtt_Password; //MQTT broker user password
-const int Mqtt_Buffer_Size = 512; //powiększony bufor ze względu na systemStatus (do usunięcie, gdy systemStatus będzie okrojony do informacji zmieniających się)
-
-const int Blinds_Count = 4; //ilość obsługiwanych rolet
-const int Blinds_Id[4] = {3,4,5,6}; //id rolet obsługiwanych przez to urządzenie
-const int Mcp_Up_Pin[4] = {12,15,10,9}; //numery pinów MCP sterujących przejazdem w górę
-const int Mcp_Down_Pin[4] = {13,14,11,8}; //numery pinów MCP sterujących przejazdem w dół
-const int Mcp_Sensor_Up_Pin[4] = {0,2,5,6}; //numery pinów MCP krańcówek górnych
-const int Mcp_Sensor_Down_Pin[4] = {1,3,4,7}; //numery pinów MCP krańcówek dolnych
-const int Blinds_Speed_Pin[4] = {26,25,33,32}; //numery pinów ESP sterujących prędkością
-bool Blinds_Move_Up[4] = {}; //stan dla pinów MCP dla przejazdów w górę
-bool Blinds_Move_Down[4] = {}; //stan dla pinów MCP dla przejazdów w dół
-bool Blinds_Sensor_Up[4] = {}; //stan MCP na pinach wejściowych krańcówej górnych
-bool Blinds_Sensor_Down[4] = {}; //stan MCP na pinach wejściowyck krańcówek dolnych
-bool Blinds_To_Calibrate[4] = {}; //wskaźniki, czy skalibrować roletę
-float Blinds_Position[4] = {}; //aktualne pozycje rolet w %
-int Blinds_Speed_Set[4] {100,100,100,100}; //nastawienie prędkości rolety w %
-int Blinds_Runtime_Up[4] = {}; //czas przebiegu rolet w górę - ze 100% do 0%
-int Blinds_Runtime_Down[4] = {}; //czas przebiegu rolet w dół - z 0% do 100%
-int Blinds_Pass_Up[4] = {}; //czas przejazdu poza górną krańcówkę
-int Blinds_Pass_Down[4] = {}; //czas przejazdu poza dolną krańcówkę
-int Blinds_Set[4] = {}; //wymagane położenie rolet otrzymane przez MQTT
-
-WiFiClient wifiClient;
-PubSubClient mqttClient(wifiClient);
-OneWire oneWire(15);
-DallasTemperature sensors(&oneWire);
+const int Mqtt_Wait_Timeout = 100; //maksymalny czas oczekiwania zadania MQTT na dane w ms (nadzór połączenia, keepalive)
+volatile int32_t Mqtt_Latency_Ms = -1; //opóźnienie ostatniej wiadomości z polem "ts" od wysłania do callback (-1 brak pomiaru)
+volatile int32_t Mqtt_Latency_Max_Ms = -1; //maksymalne opóźnienie od ostatniej telemetrii
+const int Mqtt_Buffer_Size = 768; //bufor klienta MQTT - mieści scenę z 32 roletami, dłuższe publikacje wysyłane strumieniowo (halMqttPublish)
+const int Descriptor_Json_Size = 384; //opis urządzenia z najdłuższym SSID (publishDescriptor) - do 291 B
+const int Status_Json_Size = 384; //telemetria (systemStatus) - do 321 B
+const int Metrics_Json_Size = 2560; //metryki (publishMetrics) - 16 zadań i 9 histogramów, 1363 B zmierzone przy 11 zadaniach
+const int Telemetry_Sample_Ms = 10000; //okres odczytu wartości telemetrii w ms
+const int Telemetry_Heartbeat_Ms = 900000; //maksymalny odstęp między wiadomościami telemetrii w ms
+const int Telemetry_Rssi_Delta = 5; //zmiana siły sygnału WiFi w dBm wymuszająca wysłanie telemetrii
+const float Telemetry_Temperature_Delta = 0.5; //zmiana temperatury w °C wymuszająca wysłanie telemetrii
+const uint32_t Telemetry_Heap_Delta = 4096; //zmiana wolnej sterty w bajtach wymuszająca wysłanie telemetrii
+std::atomic<bool> Telemetry_Force{false}; //telemetria do wysłania w najbliższym odczycie (nowe połączenie MQTT)
+const uint8_t Temp_Resolution = 12; //rozdzielczość DS18B20 w bitach (9..12, konwersja od 94 do 750 ms)
+const int Temp_Sample_Ms = 2000; //okres pomiaru temperatury w ms - dłuższy niż czas konwersji
+const int Temp_Sensors_Max = 8; //maksymalna liczba czujników DS18B20 na magistrali
+const float Temp_Disconnected = -127; //brak odczytu czujnika (DEVICE_DISCONNECTED_C)
+uint8_t Temp_Count = 0; //liczba czujników znalezionych w setup()
+std::atomic<float> Temperatures[Temp_Sensors_Max]; //ostatnie odczyty czujników - własność temperatureLoop
+const int Api_Url_Size = 96; //bufor adresu żądania API (API_URL ze ścieżką)
+const int Api_Payload_Size = 512; //bufor treści żądania API - mieści token refresh
+
+const int Blinds_Max = 32; //maksymalna liczba rolet urządzenia - 8 układów MCP23017 po 4 rolety
+const int Mcp_Max = 8; //maksymalna liczba układów MCP23017 na magistrali (adresy 0x20..0x27)
+// okablowanie rolet - z konfiguracji API (zapis w NVS "wiring"), bez niej domyślne: 4 rolety na układzie 0x20
+int Blinds_Count = 4; //ilość obsługiwanych rolet
+int Blinds_Id[Blinds_Max] = {3,4,5,6}; //id rolet obsługiwanych przez to urządzenie
+uint8_t Blinds_Chip[Blinds_Max] = {}; //numer układu MCP rolety (adres 0x20 + numer)
+int Mcp_Up_Pin[Blinds_Max] = {12,15,10,9}; //numery pinów MCP sterujących przejazdem w górę
+int Mcp_Down_Pin[Blinds_Max] = {13,14,11,8}; //numery pinów MCP sterujących przejazdem w dół
+int Mcp_Sensor_Up_Pin[Blinds_Max] = {0,2,5,6}; //numery pinów MCP krańcówek górnych
+int Mcp_Sensor_Down_Pin[Blinds_Max] = {1,3,4,7}; //numery pinów MCP krańcówek dolnych
+int Blinds_Speed_Pin[Blinds_Max] = {26,25,33,32}; //numery pinów ESP sterujących prędkością, -1 = bez sterowania prędkością
+int Mcp_Count = 1; //zakres numerów układów MCP - najwyższy numer układu w okablowaniu + 1
+uint8_t Mcp_Chips = 1; //maska układów MCP z podłączonymi roletami (zworki adresowe nie muszą być kolejne)
+bool Board_Started = false; //MCP skonfigurowane według okablowania - zmiana okablowania wymaga restartu
+const int Blinds_Id_Max = 256; //zakres id rolet w tablicy Blinds_Index
+int8_t Blinds_Index[Blinds_Id_Max]; //indeks rolety po id (-1 = roleta innego urządzenia), wypełniane w loadWiring()
+std::atomic<int> Blinds_Speed_Set[Blinds_Max] = {}; //nastawienie prędkości rolety w % - zapis w serii nastawień (Blinds_Set_Batch)
+const int Speed_Table_Max = 8; //punkty kalibracji prędkości rolety
+typedef struct {
+  uint8_t count; //liczba punktów, 0 = prędkość proporcjonalna do wypełnienia
+  uint8_t duty[Speed_Table_Max]; //wypełnienie PWM w % - rosnąco, poniżej 100
+  uint8_t velocity[Speed_Table_Max]; //prędkość rolety w % prędkości przy pełnym wypełnieniu (przy niej mierzone są czasy przejazdu)
+} SpeedTable;
+SeqLock<SpeedTable> Blinds_Speed_Table[Blinds_Max]; //kalibracja prędkości rolet z API - "speed_table": [[wypełnienie, prędkość], ...]
+const int Pwm_Clock_Hz = 80000000; //zegar LEDC - częstotliwość razy 2^rozdzielczość nie może go przekroczyć
+const int Pwm_Frequency_Default = 1000;
+const int Pwm_Resolution_Default = 10;
+int Pwm_Frequency = Pwm_Frequency_Default; //częstotliwość PWM sterowania prędkością w Hz (API "pwm_frequency", od startu płytki)
+int Pwm_Resolution = Pwm_Resolution_Default; //rozdzielczość PWM w bitach (API "pwm_resolution", od startu płytki)
+std::atomic<int> Speed_Ramp_Ms{0}; //narastanie wypełnienia od 0 do 100% w ms, 0 = bez rampy (API "speed_ramp")
+int Blinds_Runtime_Up[Blinds_Max] = {}; //czas przebiegu rolet w górę - ze 100% do 0% (po starcie pisze tylko silnik ruchu)
+int Blinds_Runtime_Down[Blinds_Max] = {}; //czas przebiegu rolet w dół - z 0% do 100%
+int Blinds_Pass_Up[Blinds_Max] = {}; //czas przejazdu poza górną krańcówkę
+int Blinds_Pass_Down[Blinds_Max] = {}; //czas przejazdu poza dolną krańcówkę
+
+// rozmieszczenie zadań na rdzeniach i ich priorytety - jedyne miejsce, w którym są ustalane
+// rdzeń 1 (aplikacyjny): silnik ruchu, I2C i dziennik - bez WiFi, lwIP i blokujących żądań HTTP
+// rdzeń 0 (sieciowy): WiFi (23), esp_timer (22), lwIP (18) oraz MQTT, API, tokeny, telemetria i OneWire
+const BaseType_t App_Core = 1;
+const BaseType_t Net_Core = 0;
+const UBaseType_t Motion_Priority = 20; //najwyższy na rdzeniu aplikacyjnym - tick wywłaszcza wszystko poza przerwaniami
+const UBaseType_t Mcp_Priority = 19; //odczyt krańcówek i zapis przekaźników zaraz po ticku
+const UBaseType_t Journal_Priority = tskIDLE_PRIORITY + 1; //zapis flash w tle, poniżej silnika ruchu i I2C
+const UBaseType_t Mqtt_Priority = 5; //odbiór poleceń ponad pozostałymi zadaniami sieciowymi, poniżej lwIP
+const UBaseType_t Api_Priority = tskIDLE_PRIORITY + 1; //apiUpdatePosition, apiSync i odświeżanie tokenów
+const UBaseType_t Telemetry_Priority = tskIDLE_PRIORITY; //publishBlinds, systemStatus i temperatureLoop
+
+// stan współdzielony między zadaniami - każda zmienna ma jednego pisarza:
+// callback -> Blinds_Set, Blinds_Calibrate_Request; mcpLoop -> Mcp_Inputs; motionTick -> Mcp_Requested, Mcp_Pass, Blinds_State
+std::atomic<int> Blinds_Set[Blinds_Max] = {}; //wymagane położenie rolet otrzymane przez MQTT
+std::atomic<uint32_t> Blinds_Set_Batch{0}; //licznik zapisów Blinds_Set z jednej wiadomości - nieparzysty w trakcie zapisu
+const int Groups_Max = 8; //maksymalna liczba grup rolet z konfiguracji API
+const int Group_Name_Size = 16; //nazwa grupy w temacie ssh/blinds/set/group/<nazwa>
+const int Nvs_String_Size = 768; //najdłuższy tekst w NVS - okablowanie 32 rolet
+typedef struct {
+  int count;
+  char name[Groups_Max][Group_Name_Size];
+  uint32_t mask[Groups_Max]; //rolety tego urządzenia w grupie (bit = indeks rolety)
+} BlindGroups;
+SeqLock<BlindGroups> Blinds_Groups; //grupy rolet - zapisywane przez loadBootCache i apiGetConfig, przejmowane przez callback (tryRead)
+std::atomic<uint32_t> Blinds_Calibrate_Request[Blinds_Max] = {}; //licznik żądań kalibracji otrzymanych przez MQTT
+std::atomic<uint16_t> Mcp_Inputs[Mcp_Max] = {}; //ostatni odczyt GPIOAB z każdego układu MCP (bit = numer pinu)
+std::atomic<uint16_t> Mcp_Requested[Mcp_Max] = {}; //wyjścia MCP żądane przez silnik ruchu (przed blokadą krańcówek)
+std::atomic<uint16_t> Mcp_Pass[Mcp_Max] = {}; //wyjścia MCP z jazdą za krańcówkę (pass) - bez blokady krańcówek w mcpLoop
+volatile uint32_t Mcp_I2C_Rate = 0; //liczba transakcji I2C w ostatniej sekundzie
+const int Mcp_Idle_Poll = 100; //okres kontrolnego odczytu MCP w ms, gdy żaden silnik nie pracuje
+const int Mcp_Moving_Poll = 10; //okres kontrolnego odczytu MCP w ms podczas pracy silników (krańcówki obsługuje przerwanie)
+TaskHandle_t Mcp_Task = NULL; //zadanie mcpLoop - budzone przerwaniem MCP i zmianą kierunku silników
+
+enum BlindState {BLIND_IDLE, BLIND_UP, BLIND_DOWN, BLIND_OVERTRAVEL, BLIND_PASS, BLIND_CALIBRATING};
+// BLIND_OVERTRAVEL - pozycja krańcowa osiągnięta z modelu, jazda dalej aż do krańcówki
+// BLIND_PASS - krańcówka osiągnięta, jazda dalej przez czas pass (Blinds_Pass_Up/Down)
+const int Endstop_Search_Percent = 10; //najdłuższa jazda za pozycję krańcową z modelu w poszukiwaniu krańcówki, % przejazdu
+const float Runtime_Adjust_Gain = 0.5; //część błędu pełnego przejazdu (od krańcówki do krańcówki) korygująca czas przejazdu
+const float Runtime_Adjust_Max = 10; //większy błąd pełnego przejazdu w % to przeszkoda lub poślizg - czas przejazdu bez zmian
+typedef struct {
+  uint16_t position; //pozycja rolety w 0.01%
+  uint8_t blind; //id rolety - wpisy niezależne od kolejności rolet w okablowaniu
+  int8_t direction; //kierunek pracy silnika: -1 w górę, 1 w dół, 0 postój (pozycja dokładna)
+  uint8_t target; //nastawienie, do którego jedzie roleta
+  uint8_t calibrating; //kalibracja w toku - pozycja nieznana
+} JournalEntry;
+typedef struct {
+  BlindState state; //stan maszyny stanów rolety
+  int direction; //kierunek pracy silnika: -1 w górę, 1 w dół, 0 postój
+  int target; //nastawienie, do którego aktualnie jedzie roleta
+  int set; //nastawienie obowiązujące w ticku - wszystkie rolety z jednej wiadomości zmieniają je w tym samym ticku
+  int speed; //nastawienie prędkości w % obowiązujące w ticku
+  int64_t moveStart; //czas startu silnika (lub dojazdu do krańcówki) w us
+  int64_t segmentStart; //początek odcinka jazdy ze stałym wypełnieniem w us - zmiana wypełnienia zaczyna nowy odcinek
+  float startPosition; //pozycja rolety na początku odcinka jazdy
+  float duty; //wypełnienie PWM w % (w trakcie rampy rośnie co tick)
+  float velocity; //prędkość odcinka jazdy - ułamek prędkości przy pełnym wypełnieniu
+  int phase; //etap kalibracji: 0 dojazd do górnej krańcówki, 1 pomiar w dół, 2 pomiar w górę
+  float position; //aktualna pozycja rolety w %
+  uint32_t calibrateHandled; //ostatnie obsłużone żądanie kalibracji (Blinds_Calibrate_Request)
+  uint32_t calibrations; //liczba zmian czasów przejazdu - zakończone kalibracje i korekty po pełnych przejazdach
+  uint32_t timingsHandled; //ostatni przejęty odczyt czasów z API (Blinds_Api_Timings_Request)
+  int8_t homed; //krańcówka, na której roleta stanęła od uruchomienia: -1 górna, 1 dolna, 0 brak (pozycja z modelu ruchu)
+  bool fullTravel; //jazda od krańcówki do przeciwnej z pełną prędkością - pomiar czasu przejazdu
+  float beyond; //przejazd za krańcówkę (pass) w % ze znakiem kierunku - odrabiany na początku kolejnej jazdy
+  float drift; //błąd modelu ruchu skorygowany na krańcówce w bieżącej jeździe w %, NAN = bez krańcówki
+  uint32_t homings; //liczba korekt pozycji na krańcówkach
+  uint32_t missed; //jazdy do pozycji krańcowej bez zadziałania krańcówki
+  float driftSum; //suma wartości bezwzględnych błędów korygowanych na krańcówkach
+  float driftMax; //największa wartość bezwzględna błędu
+  bool active; //czy roleta w poprzednim ticku wymagała pracy silnika ruchu
+  int8_t eventDirection; //kierunek z ostatniego zdarzenia publikacji
+  bool eventRetry; //zdarzenie przepadło przy pełnej kolejce - ponowienie w kolejnym ticku
+  int eventStep; //pozycja w pełnych % z ostatniego zdarzenia publikacji
+  int eventSet; //nastawienie z ostatniego zdarzenia publikacji
+  int eventSpeed; //nastawienie prędkości z ostatniego zdarzenia publikacji
+  JournalEntry journal; //ostatni stan przekazany do dziennika
+  int64_t journalTime; //czas przekazania stanu do dziennika w us
+} BlindMotion;
+BlindMotion Blinds_Motion[Blinds_Max] = {}; //stan ruchu rolet - własność motionTick
+bool Blinds_Disabled[Blinds_Max] = {}; //roleta bez kanału PWM na pinie prędkości (silnik nie ruszy) - pomijana przez silnik ruchu, zapis w startBoard
+typedef struct {
+  float position; //aktualna pozycja rolety w %
+  int set; //nastawienie, na które pracuje silnik ruchu
+  int runtimeUp; //czas przejazdu w górę w ms
+  int runtimeDown; //czas przejazdu w dół w ms
+  int passUp; //czasy przejazdu za krańcówki w ms
+  int passDown;
+  uint32_t calibrations; //liczba zmian czasów przejazdu - zmiana = wyniki do wysłania do API
+  uint32_t homings; //statystyka dryfu z silnika ruchu (BlindMotion)
+  uint32_t missed;
+  float drift; //ostatni błąd skorygowany na krańcówce w %
+  float driftSum;
+  float driftMax;
+} BlindSnapshot;
+SeqLock<BlindSnapshot> Blinds_State[Blinds_Max]; //spójny obraz rolet dla publikacji MQTT i API, zapisywany przez motionTick
+const int Motion_Tick_Us = 2000; //okres ticków silnika ruchu podczas pracy rolet
+int Blinds_Api_Position[Blinds_Max] = {}; //pozycje rolet odczytane z API przy uruchomieniu
+typedef struct {
+  int runtimeUp;
+  int runtimeDown;
+  int passUp;
+  int passDown;
+  uint32_t confirmed; //Blinds_Calibrations_Confirmed sprzed żądania do API - starsze czasy lokalne ustępują wartościom z API
+} BlindTimings;
+SeqLock<BlindTimings> Blinds_Api_Timings[Blinds_Max]; //czasy przejazdu i pass odczytane z API - zapisywane przez apiGetBlinds
+std::atomic<uint32_t> Blinds_Api_Timings_Request[Blinds_Max] = {}; //licznik odczytów Blinds_Api_Timings - przejmuje je silnik ruchu
+std::atomic<uint32_t> Blinds_Calibrations_Confirmed[Blinds_Max] = {}; //liczba zmian czasów przejazdu potwierdzona przez API (apiUpdatePosition)
+const int Api_Backoff_Min = 1000; //pierwsze opóźnienie ponowienia wysyłki do API w ms
+const int Api_Backoff_Max = 60000; //maksymalne opóźnienie ponowienia wysyłki do API w ms
+TaskHandle_t Api_Task = NULL; //zadanie apiUpdatePosition - budzone przez silnik ruchu po zatrzymaniu rolety
+TaskHandle_t Motion_Task = NULL; //zadanie motionLoop - budzone przez callback (nowe nastawienie) i mcpLoop (krańcówki)
+FlashJournal<JournalEntry> Journal; //dziennik ruchu rolet we flash - pozycje po utracie zasilania w trakcie jazdy
+SeqLock<JournalEntry> Journal_State[Blinds_Max]; //stan rolet do zapisu w dzienniku - zapisywany przez motionTick
+const int Journal_Checkpoint_Ms = 250; //okres wpisu pozycji jadącej rolety do dziennika
+const int Journal_Write_Interval_Ms = 100; //minimalny odstęp serii zapisów dziennika - zmiany w tym czasie łączą się w jeden rekord
+const int Journal_Prepared_Sectors = 8; //sektory dziennika kasowane z wyprzedzeniem na postoju - ok. 20 s ciągłej jazdy 32 rolet bez kasowania
+TaskHandle_t Journal_Task = NULL; //zadanie journalLoop - budzone przez silnik ruchu
+enum BlindEventType {BLIND_EVENT_START, BLIND_EVENT_STOP, BLIND_EVENT_ENDSTOP, BLIND_EVENT_PROGRESS};
+typedef struct {
+  uint8_t blind; //indeks rolety
+  uint8_t type; //BlindEventType
+  uint8_t set; //nastawienie
+  int8_t direction; //kierunek pracy silnika po zdarzeniu
+  uint8_t target; //cel jazdy rozpoczętej zdarzeniem (przy kalibracji krańcówka)
+  uint8_t speed; //nastawienie prędkości jazdy w %
+  float position; //pozycja rolety w %
+  float drift; //błąd skorygowany na krańcówce przy zatrzymaniu w %, NAN = bez krańcówki
+  int64_t time; //czas zdarzenia w us (esp_timer_get_time)
+} BlindEvent;
+EventQueue<BlindEvent, 64> Blinds_Events; //zdarzenia silnika ruchu dla publishBlinds - start, stop, krańcówka i postęp jazdy
+std::atomic<uint32_t> Blinds_Events_Lost{0}; //rolety ze zdarzeniem utraconym przy pełnej kolejce (bit = indeks) - publikacja z Blinds_State
+TaskHandle_t Publish_Task = NULL; //zadanie publishBlinds - budzone przez silnik ruchu po zdarzeniach
+const int Publish_Interval_Default_Ms = 1000;
+const int Publish_Step_Default = 5;
+std::atomic<int> Publish_Interval_Ms{Publish_Interval_Default_Ms}; //minimalny odstęp publikacji postępu jazdy rolety w ms (API "publish_interval")
+std::atomic<int> Publish_Step{Publish_Step_Default}; //minimalna zmiana pozycji jadącej rolety w % między publikacjami (API "publish_step")
+const int Publish_Retry_Ms = 1000; //ponowienie publikacji bez połączenia z brokerem
+
+StaticAllocator<4096> Command_Allocator; //pamięć dokumentu JSON poleceń MQTT - bez sterty w callback
+JsonDocument Command_Filter; //pola wiadomości ssh/blinds/set/... zachowywane przy parsowaniu
+
+// metryki czasu działania - publikowane na żądanie w ssh/devices/metrics/<id> (wiadomość do ssh/devices/metrics/<id>/get),
+// dryf rolet osobno w ssh/devices/metrics/<id>/drift/<id rolety>
+typedef struct {
+  char name[16];
+  std::atomic<TaskHandle_t> handle; //NULL po zakończeniu zadania
+  uint32_t stack; //rozmiar stosu podany przy tworzeniu zadania w bajtach
+  uint32_t freeAtExit; //najmniejszy wolny stos zakończonego zadania
+  std::atomic<bool> ready; //wpis wypełniony - rejestracja z kilku zadań bez blokady
+} TaskEntry;
+const int Tasks_Max = 16; //zadania z wpisem w metrykach
+TaskEntry Tasks[Tasks_Max];
+std::atomic<int> Tasks_Count{0};
+LoopMetrics Motion_Metrics; //ticki motionLoop - odchyłka od planowanego ticku co Motion_Tick_Us
+LoopMetrics Mcp_Metrics; //cykle mcpLoop - odchyłka od wybudzenia przerwaniem, silnikiem ruchu lub upływu okresu odczytu
+std::atomic<uint32_t> Mcp_Wake_Us{0}; //chwila pierwszego wybudzenia mcpLoop od poprzedniego cyklu (młodsze 32 bity esp_timer), 0 = brak
+Histogram I2c_Time; //czas pojedynczego odczytu lub zapisu GPIOAB
+Histogram Http_Time; //czas żądania API (z połączeniem)
+Histogram Mqtt_Time; //opóźnienie poleceń MQTT z polem "ts" od wysłania do callback
 
 const String myHostname = "ssh_device_" + DEVICE_ID;
-typedef struct {int param;} TaskParams;
 
 void connectWiFi();
+void startMotionTasks();
 void callback(char*, byte*, unsigned int);
+int blindIndex(const char*);
+uint32_t groupMask(const char*);
+void applySets(const int*, const int*);
 void connectMqtt();
+void mqttLoop(void*);
 void mcpLoop(void*);
-void calibrateBlind(int);
-void setBlinds(void*);
+void mcpInterrupt();
+void mcpWakeMark();
+void setMotor(int, bool, bool);
+void setPass(int);
+void motionLoop(void*);
+bool motionTick(int64_t);
+void motionWake();
+bool motionStep(int, int64_t, const uint16_t*);
+bool calibrationStep(int, int64_t, const uint16_t*);
+void publishState(int);
+void journalUpdate(int, int64_t);
+bool queueBlindEvent(int, int64_t, const uint16_t*);
+void journalLoop(void*);
+void journalPrepare(const JournalEntry*);
+void journalRestore();
+bool sensorUp(int, const uint16_t*);
+bool sensorDown(int, const uint16_t*);
+void startMotor(int, int, int64_t);
+void stopMotor(int);
+bool applyApiTimings(int);
+void homeBlind(int, int, float, int64_t, bool);
+void speedStep(int, int64_t);
+float speedVelocity(int, float);
+float travelDistance(int, int, float, int64_t);
 void publishBlinds(void*);
+bool publishMotion(int, const BlindEvent&, int64_t);
+int64_t eventUnixMs(int64_t);
+void publishDescriptor();
+void temperatureLoop(void*);
+float sensorTemperature(int);
 void systemStatus(void*);
 void publishErrors(void*);
 
 bool apiGetTokens();
 bool apiRefreshToken();
 bool apiGetConfig();
-bool apiGetBlinds();
+bool apiGetBlinds(bool);
+bool loadBootCache();
+void nvsUpdateInt(const char*, int32_t);
+void nvsUpdateString(const char*, const char*);
+void loadGroups(const char*);
+void loadWiring();
+int parseWiring(const char*, bool);
+bool validWiring(int, int, int, int, int, int, int);
+bool parseSpeedTable(const char*, SpeedTable*);
+void wiringText(char*, size_t);
+void startBoard();
+void restorePendingPositions();
+void apiSync(void*);
+void startTokenTasks();
+int apiRequest(const char*, const char*, const char*, const String&, String*);
+void registerTask(TaskHandle_t, uint32_t);
+void taskFinished();
+void publishMetrics();
+void publishDrift();
 void xGetTokens(void*);
 void xRefreshToken(void*);
 void apiUpdatePosition(void*);
@@ -83,134 +327,193 @@ void setup()
   pinMode(BUILT_LED, OUTPUT);
   digitalWrite(BUILT_LED, LOW);
 
-  Wire.begin(21,22);
-
-  if (!mcp.begin_I2C()) {
-    Serial.println("MCP23017 Error");
-    while (true);
-  }
+  TaskHandle_t task = NULL;
+  registerTask(xTaskGetCurrentTaskHandle(), CONFIG_ARDUINO_LOOP_STACK_SIZE); //setup() w loopTask
+  halCpuLoadBegin();
+  halNvsBegin();
+  loadWiring();
 
-  for (int i=0; i < Blinds_Count; i++)
+  Temp_Count = halTempBegin(Temp_Resolution);
+  for (int i=0; i < Temp_Sensors_Max; i++)
   {
-    mcp.pinMode(Mcp_Up_Pin[i], OUTPUT);
-    mcp.digitalWrite(Mcp_Up_Pin[i], HIGH);
-    mcp.pinMode(Mcp_Down_Pin[i], OUTPUT);
-    mcp.digitalWrite(Mcp_Down_Pin[i], HIGH);
-    mcp.pinMode(Mcp_Sensor_Up_Pin[i], INPUT);
-    mcp.pinMode(Mcp_Sensor_Down_Pin[i], INPUT);
-    pinMode(Blinds_Speed_Pin[i], OUTPUT);
-    digitalWrite(Blinds_Speed_Pin[i], LOW);
+    Temperatures[i] = Temp_Disconnected;
   }
 
-  xTaskCreate(
-    mcpLoop,           // Function that should be called
-    "MCP Read Write",  // Name of the task (for debugging)
-    3000,              // Stack size (bytes)
-    NULL,              // Parameter to pass
-    10,                // Task priority
-    NULL               // Task handle
+  xTaskCreatePinnedToCore( //przed połączeniem z WiFi - pierwszy odczyt gotowy przed telemetrią
+    temperatureLoop,
+    "Temperature",
+    2000,
+    NULL,
+    Telemetry_Priority,
+    &task,
+    Net_Core           // OneWire blokuje przerwania na czas bitu - z dala od ticków ruchu
   );
-
-  connectWiFi();
-  while (!apiGetTokens()) { delay(1000); }
-  delay(100);
-  while (!apiGetConfig()) { delay(1000); }
-  while (!apiGetBlinds()) { delay(1000); }
-  connectMqtt();
-
-  for(int i = 0; i < Blinds_Count; i++)
-  {
-    TaskParams* params = new TaskParams;
-    params->param = i;
-    String s = "Task_" + String(i);
-    char* taskName = strdup(s.c_str());
-
-    xTaskCreate(
-      setBlinds,
-      taskName,
-      3000,
-      params,
-      1,
-      NULL
-    );
+  registerTask(task, 2000);
+
+  Command_Filter["set"] = true;
+  Command_Filter["speed"] = true;
+  Command_Filter["calibrate"] = true;
+  Command_Filter["ts"] = true;
+  Command_Filter["blinds"][0]["id"] = true;
+  Command_Filter["blinds"][0]["group"] = true;
+  Command_Filter["blinds"][0]["set"] = true;
+
+  bool cached = loadBootCache();
+  if (cached)
+  { // silnik ruchu ze stanu w NVS przed siecią - WiFi i MQTT łączy zadanie mqttLoop, API uzgadnia apiSync
+    startBoard();
+    journalRestore();
+    startMotionTasks();
+  }
+  else
+  { // pierwsze uruchomienie - bez konfiguracji w NVS start dopiero po odpowiedzi API
+    // MCP konfigurowane po odczycie okablowania z API
+    connectWiFi();
+    while (!apiGetTokens()) { delay(1000); }
+    delay(100);
+    while (!apiGetConfig()) { delay(1000); }
+    startBoard();
+    while (!apiGetBlinds(true)) { delay(1000); }
+    restorePendingPositions();
+    halNvsSetInt("cache", Boot_Cache_Version);
+    Api_Synced = true;
+    journalRestore();
+    startMotionTasks();
   }
+  // połączenie z brokerem nawiązuje i odnawia mqttLoop - zadania publikacji i API startują bez czekania na nie
+  halMqttSetup(Mqtt_Server.c_str(), Mqtt_Port, callback, Mqtt_Buffer_Size);
 
-  xTaskCreate(
+  xTaskCreatePinnedToCore(
     publishBlinds,
     "Blinds publish",
     3000,
     NULL,
-    tskIDLE_PRIORITY,
-    NULL
+    Telemetry_Priority,
+    &Publish_Task,
+    Net_Core
   );
+  registerTask(Publish_Task, 3000);
 
-  xTaskCreate(
+  xTaskCreatePinnedToCore(
     systemStatus,
     "System status",
     3000,
     NULL,
-    tskIDLE_PRIORITY,
-    NULL
+    Telemetry_Priority,
+    &task,
+    Net_Core
   );
+  registerTask(task, 3000);
 
-  xTaskCreate(
-    xRefreshToken,
-    "Refresh API Token",
-    3000,
+  xTaskCreatePinnedToCore(
+    apiUpdatePosition,
+    "Update blinds position in API",
+    4000,
     NULL,
-    tskIDLE_PRIORITY,
-    NULL
+    Api_Priority,
+    &Api_Task,
+    Net_Core
   );
+  registerTask(Api_Task, 4000);
 
-  xTaskCreate(
-    xGetTokens,
-    "Get new API Tokens",
-    3000,
+  if (Api_Synced)
+  {
+    startTokenTasks();
+  }
+  else
+  {
+    xTaskCreatePinnedToCore(
+      apiSync,
+      "API sync",
+      4000,
+      NULL,
+      Api_Priority,
+      &task,
+      Net_Core
+    );
+    registerTask(task, 4000);
+  }
+
+  xTaskCreatePinnedToCore(
+    mqttLoop,
+    "MQTT",
+    4000,
     NULL,
-    tskIDLE_PRIORITY,
-    NULL
+    Mqtt_Priority,
+    &task,
+    Net_Core
   );
+  registerTask(task, 4000);
+}
 
-  xTaskCreate(
-    apiUpdatePosition,
-    "Update blinds position in API",
+void startMotionTasks()
+{ // dziennik i silnik ruchu - po odtworzeniu pozycji rolet (journalRestore)
+  xTaskCreatePinnedToCore( //przed silnikiem ruchu - zapisuje każdą zmianę ruchu od pierwszego ticku
+    journalLoop,
+    "Journal",
     3000,
     NULL,
-    tskIDLE_PRIORITY,
-    NULL
+    Journal_Priority,
+    &Journal_Task,
+    App_Core
   );
+  registerTask(Journal_Task, 3000);
+
+  xTaskCreatePinnedToCore(
+    motionLoop,
+    "Motion",
+    4000,
+    NULL,
+    Motion_Priority,
+    &Motion_Task,
+    App_Core
+  );
+  registerTask(Motion_Task, 4000);
+  motionWake();
 }
 
 void loop()
-{
-  if (WiFi.status() != WL_CONNECTED) { connectWiFi(); }
-  if (!mqttClient.connected()) { connectMqtt(); }
-  mqttClient.loop();
-  vTaskDelay(pdMS_TO_TICKS(1000));
+{ // nadzór połączeń i obsługa MQTT przeniesione do zadania mqttLoop
+  taskFinished();
+  vTaskDelete(NULL);
+}
+
+void mqttLoop(void* parameters)
+{ // odbiór MQTT - zadanie czeka na gotowość gniazda, więc callback rusza zaraz po nadejściu wiadomości
+  while (true)
+  {
+    if (!halWiFiConnected()) { connectWiFi(); }
+    if (!halMqttConnected()) { connectMqtt(); }
+    halMqttLoop();
+    halMqttWait(Mqtt_Wait_Timeout);
+  }
 }
 
 
 void connectWiFi()
 { // ustanawianie połączenia WiFi
   digitalWrite(BUILT_LED, LOW);
-  WiFi.hostname(myHostname);
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  halWiFiBegin(myHostname, WIFI_SSID, WIFI_PASSWORD);
   int attempt = 0;
   Serial.print("Connecting to WiFi ");
 
-  while (WiFi.status() != WL_CONNECTED)
+  while (!halWiFiConnected())
   {
     if (attempt == 30)
-        {
+    {
+      if (Motion_Task != NULL)
+      { // rolety działają bez sieci - kolejna seria prób z mqttLoop zamiast restartu
+        Serial.println("Brak WiFi po 30 probach polaczenia");
+        return;
+      }
       Serial.println("Reboot po 30 probach polaczenia z WiFi");
       ESP.restart();
     }
     ++attempt;
     vTaskDelay(pdMS_TO_TICKS(200));
 
-    wl_status_t status = WiFi.status();
-    if(status != WL_CONNECTED) {
+    int status = halWiFiStatus();
+    if(!halWiFiConnected()) {
       digitalWrite(BUILT_LED, HIGH);
       Serial.print("   Connecting to WiFi error: ");
       Serial.println(status);
@@ -228,11 +531,13 @@ void connectWiFi()
     }
   }
 
-  WiFi_IP = WiFi.localIP().toString();
+  snprintf(WiFi_IP, sizeof(WiFi_IP), "%s", halWiFiIP().c_str());
+  snprintf(WiFi_SSID, sizeof(WiFi_SSID), "%s", halWiFiSSID().c_str());
+  snprintf(WiFi_Mac, sizeof(WiFi_Mac), "%s", halWiFiMac().c_str());
   Serial.println("Connected to WiFi:");
   Serial.println("         IP: " + String(WiFi_IP));
   Serial.println("   Hostname: " + myHostname);
-  long rssi = WiFi.RSSI();
+  long rssi = halWiFiRSSI();
   Serial.print("     Signal: ");
   Serial.print(rssi);
   Serial.println(" dBm");
@@ -242,21 +547,20 @@ void connectWiFi()
 
 bool apiGetTokens()
 { // pobierane tokenów uwierzytelniających API
-  if(WiFi.status() == WL_CONNECTED)
+  if(halWiFiConnected())
   {
-    String url = API_URL + "/token/";
-    String payload = "{\"username\":\"" + API_USERNAME + "\",\"password\":\"" + API_PASSWORD + "\"}";
+    char url[Api_Url_Size];
+    char payload[Api_Payload_Size];
+    snprintf(url, sizeof(url), "%s/token/", API_URL.c_str());
+    snprintf(payload, sizeof(payload), "{\"username\":\"%s\",\"password\":\"%s\"}", API_USERNAME.c_str(), API_PASSWORD.c_str());
 
-    HTTPClient httpClient;
-    httpClient.begin(url);
-    httpClient.addHeader("Content-Type", "application/json");
-    int httpResponseCode = httpClient.POST(payload);
+    String response;
+    int httpResponseCode = apiRequest("POST", url, payload, "", &response);
 
     if (httpResponseCode > 0) 
     {
       if (httpResponseCode == 200)
       {
-        String response = httpClient.getString();
         // Serial.println(response);
         JsonDocument doc;
         deserializeJson(doc, response);
@@ -276,28 +580,30 @@ bool apiGetTokens()
       Serial.print("API - Error on sending POST: ");
       Serial.println(httpResponseCode);
     }  
-    httpClient.end();
   }
   return false;
 }
 
 bool apiRefreshToken()
 { // odświerzenie tokenu uwierzytelniającego API tokenem refresh
-  if(WiFi.status() == WL_CONNECTED)
+  if(halWiFiConnected())
   {
-    String url = API_URL + "/token/refresh/";
-    String payload = "{\"refresh\":\"" + refreshToken + "\"}";
+    static char url[Api_Url_Size]; //bufory zadania xRefreshToken
+    static char payload[Api_Payload_Size];
+    snprintf(url, sizeof(url), "%s/token/refresh/", API_URL.c_str());
+    if (snprintf(payload, sizeof(payload), "{\"refresh\":\"%s\"}", refreshToken.c_str()) >= (int)sizeof(payload))
+    {
+      Serial.println("API - refresh token nie mieści się w buforze");
+      return false;
+    }
 
-    HTTPClient httpClient;
-    httpClient.begin(url);
-    httpClient.addHeader("Content-Type", "application/json");
-    int httpResponseCode = httpClient.POST(payload);
+    String response;
+    int httpResponseCode = apiRequest("POST", url, payload, "", &response);
 
     if (httpResponseCode > 0) 
     {
       if (httpResponseCode == 200)
       {
-        String response = httpClient.getString();
         // Serial.println(response);
         JsonDocument doc;
         deserializeJson(doc, response);
@@ -315,38 +621,144 @@ bool apiRefreshToken()
       Serial.print("API Error on sending POST: ");
       Serial.println(httpResponseCode);
     }
-  
-    httpClient.end();
   }
   return false;
 }
 
 bool apiGetConfig()
 { // pobranie dany  konfiguracyjnych przez API
-  if(WiFi.status() == WL_CONNECTED)
+  if(halWiFiConnected())
   {
-    String url = API_URL + "/configurations/1/";
-    HTTPClient httpClient;
-    httpClient.begin(url);
-    httpClient.addHeader("Content-Type", "application/json");
-    httpClient.addHeader("Authorization", "Bearer " + accessToken);
-    int httpResponseCode = httpClient.GET();
+    char url[Api_Url_Size];
+    snprintf(url, sizeof(url), "%s/configurations/1/", API_URL.c_str());
+    String response;
+    int httpResponseCode = apiRequest("GET", url, "", accessToken, &response);
 
     if (httpResponseCode > 0) 
     {
       if (httpResponseCode == 200)
       {
-        String response = httpClient.getString();
         // Serial.println(response);
         JsonDocument doc;
         deserializeJson(doc, response);
         String Ntp_Server = doc["ntp_server"].as<String>();
-        Mqtt_Server = doc["mqtt_server"].as<String>();
-        Mqtt_Port = doc["mqtt_port"].as<int>();
-        Mqtt_User = doc["mqtt_user"].as<String>();
-        Mqtt_Password = doc["mqtt_password"].as<String>();
+        String mqttServer = doc["mqtt_server"].as<String>();
+        int mqttPort = doc["mqtt_port"].as<int>();
+        String mqttUser = doc["mqtt_user"].as<String>();
+        String mqttPassword = doc["mqtt_password"].as<String>();
         Serial.println("API configs received");
 
+        JsonArray devices = doc["devices"][DEVICE_ID.c_str()].as<JsonArray>();
+        if (!devices.isNull())
+        { // okablowanie rolet tego urządzenia: [{"id","chip","up","down","sensor_up","sensor_down","speed"}]
+          static char wiring[Nvs_String_Size]; //apiGetConfig działa w jednym zadaniu naraz (setup lub apiSync)
+          static char active[Nvs_String_Size];
+          bool seen[Blinds_Id_Max] = {};
+          uint64_t speedPins = 0; //piny prędkości rolet już przyjętych - kanał PWM nie może sterować dwiema roletami
+          size_t wiringLength = 0;
+          int count = 0;
+          wiring[0] = 0;
+          for (JsonObject blind : devices)
+          {
+            int id = blind["id"] | -1;
+            int chip = blind["chip"] | 0;
+            int up = blind["up"] | -1;
+            int down = blind["down"] | -1;
+            int sensorUp = blind["sensor_up"] | -1;
+            int sensorDown = blind["sensor_down"] | -1;
+            int speed = blind["speed"] | -1;
+            if (count == Blinds_Max or !validWiring(id, chip, up, down, sensorUp, sensorDown, speed) or seen[id]
+              or (speed >= 0 and (speedPins & (1ull << speed))))
+            {
+              Serial.printf("Pominięte okablowanie rolety nr %d\n", id);
+              continue;
+            }
+            seen[id] = true;
+            if (speed >= 0) speedPins |= 1ull << speed;
+            count++;
+            wiringLength += snprintf(wiring + wiringLength, sizeof(wiring) - wiringLength, "%s%d:%d:%d:%d:%d:%d:%d",
+              wiringLength > 0 ? ";" : "", id, chip, up, down, sensorUp, sensorDown, speed);
+          }
+          wiringText(active, sizeof(active));
+          if (count > 0 and strcmp(wiring, active) != 0)
+          {
+            nvsUpdateString("wiring", wiring);
+            if (Board_Started)
+            { // tablice rolet i konfiguracja MCP są w użyciu - nowe okablowanie od ponownego uruchomienia
+              Serial.println("Zmiana okablowania rolet w API - restart");
+              ESP.restart();
+            }
+            parseWiring(wiring, true);
+            Serial.printf("Okablowanie %d rolet na %d układach MCP z API\n", Blinds_Count, Mcp_Count);
+          }
+        }
+
+        static char groups[Nvs_String_Size]; //grupy z roletami tego urządzenia: "nazwa:id,id;nazwa:id"
+        size_t groupsLength = 0;
+        groups[0] = 0;
+        for (JsonObject group : doc["groups"].as<JsonArray>())
+        {
+          const char* name = group["name"] | "";
+          if (strlen(name) == 0 or strlen(name) >= Group_Name_Size or strpbrk(name, ":;,/#+") != NULL) continue; //nazwa musi być poziomem tematu MQTT
+          char entry[Group_Name_Size + Blinds_Max * 4];
+          size_t length = snprintf(entry, sizeof(entry), "%s%s:", groupsLength > 0 ? ";" : "", name);
+          size_t header = length;
+          for (JsonVariant blind : group["blinds"].as<JsonArray>())
+          {
+            int id = blind.as<int>();
+            if (id < 0 or id >= Blinds_Id_Max or Blinds_Index[id] < 0) continue;
+            length += snprintf(entry + length, sizeof(entry) - length, "%s%d", length > header ? "," : "", id);
+          }
+          if (length == header or groupsLength + length >= sizeof(groups)) continue;
+          memcpy(groups + groupsLength, entry, length + 1);
+          groupsLength += length;
+        }
+        nvsUpdateString("groups", groups);
+        loadGroups(groups);
+
+        int publishInterval = doc["publish_interval"] | Publish_Interval_Default_Ms;
+        int publishStep = doc["publish_step"] | Publish_Step_Default;
+        Publish_Interval_Ms = max(0, min(60000, publishInterval));
+        Publish_Step = max(1, min(100, publishStep));
+        nvsUpdateInt("pub_interval", Publish_Interval_Ms);
+        nvsUpdateInt("pub_step", Publish_Step);
+
+        int pwmResolution = doc["pwm_resolution"] | Pwm_Resolution_Default;
+        pwmResolution = max(1, min(16, pwmResolution));
+        int pwmFrequency = doc["pwm_frequency"] | Pwm_Frequency_Default;
+        pwmFrequency = max(1, min(Pwm_Clock_Hz >> pwmResolution, pwmFrequency));
+        if (Board_Started and (pwmFrequency != Pwm_Frequency or pwmResolution != Pwm_Resolution))
+        { //kanały LEDC skonfigurowane przy starcie płytki
+          Serial.println("Zmiana PWM w API - nowe ustawienia od ponownego uruchomienia");
+        }
+        else
+        {
+          Pwm_Frequency = pwmFrequency;
+          Pwm_Resolution = pwmResolution;
+        }
+        Speed_Ramp_Ms = max(0, min(10000, doc["speed_ramp"] | 0));
+        nvsUpdateInt("pwm_freq", pwmFrequency);
+        nvsUpdateInt("pwm_res", pwmResolution);
+        nvsUpdateInt("speed_ramp", Speed_Ramp_Ms);
+
+        nvsUpdateString("ntp_server", Ntp_Server.c_str());
+        nvsUpdateString("mqtt_server", mqttServer.c_str());
+        nvsUpdateInt("mqtt_port", mqttPort);
+        nvsUpdateString("mqtt_user", mqttUser.c_str());
+        nvsUpdateString("mqtt_password", mqttPassword.c_str());
+        if (Mqtt_Server.length() == 0)
+        {
+          Mqtt_Server = mqttServer;
+          Mqtt_Port = mqttPort;
+          Mqtt_User = mqttUser;
+          Mqtt_Password = mqttPassword;
+        }
+        else if (mqttServer != Mqtt_Server or mqttPort != Mqtt_Port or mqttUser != Mqtt_User or mqttPassword != Mqtt_Password)
+        { // klient MQTT korzysta z konfiguracji odczytanej z NVS - nowa obowiązuje od ponownego uruchomienia
+          Serial.println("Zmiana konfiguracji MQTT w API - restart");
+          ESP.restart();
+        }
+
         // ustawienie aktualnego czau
         configTime(7200, 0, Ntp_Server.c_str(), "ntp.certum.pl");
         Serial.println("Real-time synchronization:");
@@ -358,7 +770,7 @@ bool apiGetConfig()
         }
 
         time(&now);
-        Boot_Timestamp = now;
+        Boot_Timestamp = now - millis() / 1000; //synchronizacja w tle może nastąpić długo po starcie
         Serial.print("   Unixtime: ");
         Serial.println(now); // czas uniksowy
 
@@ -367,7 +779,6 @@ bool apiGetConfig()
         Serial.print("   Datetime: ");
         Serial.println(buffer);
         
-        httpClient.end();
         return true;
       }
       else
@@ -381,7 +792,6 @@ bool apiGetConfig()
       Serial.print("API Error on sending POST: ");
       Serial.println(httpResponseCode);
     }  
-    httpClient.end();
   }
   else
   {
@@ -390,22 +800,24 @@ bool apiGetConfig()
   return false;
 }
 
-bool apiGetBlinds()
-{ // pobranie danych rolet przez API
-  if(WiFi.status() == WL_CONNECTED)
+bool apiGetBlinds(bool setPositions)
+{ // pobranie danych rolet przez API, setPositions = pozycje z API obowiązują (start bez stanu w NVS)
+  if(halWiFiConnected())
   {
-    String url = API_URL + "/blinds/";
-    HTTPClient httpClient;
-    httpClient.begin(url);
-    httpClient.addHeader("Content-Type", "application/json");
-    httpClient.addHeader("Authorization", "Bearer " + accessToken);
-    int httpResponseCode = httpClient.GET();
+    char url[Api_Url_Size];
+    snprintf(url, sizeof(url), "%s/blinds/", API_URL.c_str());
+    uint32_t confirmed[Blinds_Max]; //zmiany czasów przejazdu potwierdzone przed odczytem - późniejsze są nowsze niż odpowiedź
+    for (int i=0; i < Blinds_Count; i++)
+    {
+      confirmed[i] = Blinds_Calibrations_Confirmed[i];
+    }
+    String response;
+    int httpResponseCode = apiRequest("GET", url, "", accessToken, &response);
 
     if (httpResponseCode > 0)
     {
       if (httpResponseCode == 200)
       {
-        String response = httpClient.getString();
         // Serial.println(response);
         JsonDocument doc;
         deserializeJson(doc, response);
@@ -414,17 +826,52 @@ bool apiGetBlinds()
           for (int i=0; i < Blinds_Count; i++)
           {
             if (id == Blinds_Id[i]) {
-              Blinds_Position[i] = item["position"].as<int>();
-              Blinds_Runtime_Up[i] = item["runtime_up"].as<int>();
-              Blinds_Runtime_Down[i] = item["runtime_down"].as<int>();
-              Blinds_Pass_Up[i] = item["pass_up"].as<int>();
-              Blinds_Pass_Down[i] = item["pass_down"].as<int>();
-              Blinds_Set[i] = item["position"].as<int>();
+              // czasy przejazdu z API obowiązują także po starcie z NVS - przejmuje je silnik ruchu (applyApiTimings),
+              // a zapis w NVS robi apiUpdatePosition ze stanu rolety
+              Blinds_Api_Position[i] = item["position"].as<int>();
+              BlindTimings timings;
+              timings.runtimeUp = item["runtime_up"].as<int>();
+              timings.runtimeDown = item["runtime_down"].as<int>();
+              timings.passUp = item["pass_up"].as<int>();
+              timings.passDown = item["pass_down"].as<int>();
+              timings.confirmed = confirmed[i];
+              Blinds_Api_Timings[i].write(timings);
+              Blinds_Api_Timings_Request[i]++;
+
+              char key[16];
+              char table[Speed_Table_Max * 8 + 1]; //"wypełnienie:prędkość,..." - zapis w NVS
+              size_t length = 0;
+              table[0] = 0;
+              for (JsonVariant point : item["speed_table"].as<JsonArray>())
+              {
+                length += snprintf(table + length, sizeof(table) - length, "%s%d:%d", length > 0 ? "," : "", point[0].as<int>(), point[1].as<int>());
+                if (length >= sizeof(table)) break;
+              }
+              SpeedTable speedTable;
+              if (length >= sizeof(table) or !parseSpeedTable(table, &speedTable))
+              {
+                Serial.printf("Błędna kalibracja prędkości rolety nr %d - prędkość proporcjonalna do wypełnienia\n", id);
+                table[0] = 0;
+                parseSpeedTable(table, &speedTable);
+              }
+              Blinds_Speed_Table[i].write(speedTable);
+              snprintf(key, sizeof(key), "spd%d", id);
+              nvsUpdateString(key, table);
+
+              if (setPositions)
+              { //pierwsze uruchomienie - silnik ruchu jeszcze nie działa
+                applyApiTimings(i);
+                Blinds_Motion[i].position = Blinds_Api_Position[i];
+                Blinds_Set[i] = Blinds_Api_Position[i];
+                publishState(i);
+                snprintf(key, sizeof(key), "last%d", id);
+                nvsUpdateInt(key, Blinds_Api_Position[i]);
+              }
               break;
             }
           }
         }
-        httpClient.end();
+        motionWake(); //czasy przejazdu do przejęcia przez silnik ruchu
         return true;
       }
       else
@@ -438,7 +885,6 @@ bool apiGetBlinds()
       Serial.print("API Error on sending POST: ");
       Serial.println(httpResponseCode);
     }  
-    httpClient.end();
   }
   else
   {
@@ -475,6 +921,56 @@ void xRefreshToken(void* parameters)
   }
 }
 
+void startTokenTasks()
+{ // odświeżanie tokenów od chwili pierwszego pobrania
+  TaskHandle_t task = NULL;
+  xTaskCreatePinnedToCore(
+    xRefreshToken,
+    "Refresh API Token",
+    3000,
+    NULL,
+    Api_Priority,
+    &task,
+    Net_Core
+  );
+  registerTask(task, 3000);
+
+  xTaskCreatePinnedToCore(
+    xGetTokens,
+    "Get new API Tokens",
+    3000,
+    NULL,
+    Api_Priority,
+    &task,
+    Net_Core
+  );
+  registerTask(task, 3000);
+}
+
+int apiRequest(const char* method, const char* url, const char* payload, const String& token, String* response)
+{ // żądanie API z pomiarem czasu do metryk
+  int64_t start = esp_timer_get_time();
+  int code = halHttpRequest(method, url, payload, token, response);
+  Http_Time.record(esp_timer_get_time() - start);
+  return code;
+}
+
+void apiSync(void* parameters)
+{ // uzgodnienie z API po starcie z NVS - rolety działają w tym czasie ze stanu zapisanego w NVS
+  uint32_t backoff = Api_Backoff_Min;
+  while (!(halWiFiConnected() and apiGetTokens() and apiGetConfig() and apiGetBlinds(false)))
+  {
+    vTaskDelay(pdMS_TO_TICKS(backoff));
+    backoff = min(backoff * 2, (uint32_t)Api_Backoff_Max);
+  }
+  Api_Synced = true;
+  xTaskNotifyGive(Api_Task); //pozycje zmienione bez API do wysłania
+  Serial.printf("API zsynchronizowane po %lu ms od uruchomienia\n", millis());
+  startTokenTasks();
+  taskFinished();
+  vTaskDelete(NULL);
+}
+
 void connectMqtt()
 { // ustanawianie połączenia MQTT
   digitalWrite(BUILT_LED, LOW);
@@ -482,31 +978,37 @@ void connectMqtt()
   char myMqttName[hostnameLenght];
   myHostname.toCharArray(myMqttName, hostnameLenght);
 
-  mqttClient.setServer(Mqtt_Server.c_str(), Mqtt_Port);
-  mqttClient.setCallback(callback);
-  mqttClient.setBufferSize(Mqtt_Buffer_Size);
+  //willMessage:
+  char willTopic[40];
+  char json[128];
+  snprintf(willTopic, sizeof(willTopic), "ssh/devices/status/%s", DEVICE_ID.c_str());
+  snprintf(json, sizeof(json), "{\"device\":{\"id\":%s,\"name\":\"%s\",\"type\":\"%s\",\"online\":false}}",
+    DEVICE_ID.c_str(), myHostname.c_str(), ESP.getChipModel());
 
-  while (!mqttClient.connected()) {
-    vTaskDelay(pdMS_TO_TICKS(500));
+  while (!halMqttConnected()) { //pierwsza próba od razu - opóźnienie tylko po błędzie
     digitalWrite(BUILT_LED, HIGH);
     Serial.println("Connecting to MQTT...");
 
-    //willMessage:
-    String json = "{\"device\":{\"id\":" + DEVICE_ID 
-    + ",\"name\":\"" + myHostname 
-    + "\",\"type\":\"" + ESP.getChipModel() 
-    + "\",\"online\":false}}";
-
-    if (mqttClient.connect(myMqttName, Mqtt_User.c_str(), Mqtt_Password.c_str(), String("ssh/devices/status/" + DEVICE_ID).c_str(), 1, true, json.c_str()))
+    if (halMqttConnect(myMqttName, Mqtt_User.c_str(), Mqtt_Password.c_str(), willTopic, 1, true, json))
     {
       Serial.println("Connected to MQTT");
-      mqttClient.subscribe("ssh/blinds/set/#"); //kanał wiadomości nastawiania rolet
-      // mqttClient.publish("ssh/test", "hello");
+      halMqttSubscribe("ssh/blinds/set/#"); //kanał wiadomości nastawiania rolet
+      char metricsTopic[48];
+      snprintf(metricsTopic, sizeof(metricsTopic), "ssh/devices/metrics/%s/get", DEVICE_ID.c_str());
+      halMqttSubscribe(metricsTopic); //żądanie metryk - odpowiedź w ssh/devices/metrics/<id>
+      if (Boot_Ready_Ms < 0)
+      {
+        Boot_Ready_Ms = millis();
+        Serial.printf("Gotowe po %d ms od uruchomienia\n", (int)Boot_Ready_Ms);
+      }
+      publishDescriptor();
+      Telemetry_Force = true;
+      // halMqttPublish("ssh/test", "hello", false);
     } 
     else 
     {
       Serial.print("MQTT Client Failed with state ");
-      Serial.println(mqttClient.state());
+      Serial.println(halMqttState());
         // -4 : MQTT_CONNECTION_TIMEOUT - the server didn't respond within the keepalive time
         // -3 : MQTT_CONNECTION_LOST - the network connection was broken
         // -2 : MQTT_CONNECT_FAILED - the network connection failed
@@ -518,7 +1020,7 @@ void connectMqtt()
         //  4 : MQTT_CONNECT_BAD_CREDENTIALS - the username/password were rejected
         //  5 : MQTT_CONNECT_UNAUTHORIZED - the client was not authorized to connect
       
-      if (WiFi.status() != WL_CONNECTED) 
+      if (!halWiFiConnected()) 
       {
         Serial.println("WiFi disconnected!");
         break;
@@ -531,378 +1033,1701 @@ void connectMqtt()
 }
 
 void callback(char* topic, byte* payload, unsigned int length)
-{ //odebranie wiadomości MQTT
-  char *token;
-  const char *delimiter ="/";
-  String splitTopic[4] = {};
-  token = strtok(topic, delimiter);
+{ //odebranie wiadomości MQTT - bez alokacji na stercie: temat porównywany w miejscu, JSON w stałym buforze z filtrem
+  // ssh/blinds/set/<id> - jedna roleta, ssh/blinds/set/group/<nazwa> - grupa z konfiguracji API,
+  // ssh/blinds/set/scene - {"blinds":[{"id":3,"set":40},{"group":"salon","set":0}]}
+  static const char setPrefix[] = "ssh/blinds/set/";
+  static const char groupPrefix[] = "group/";
+  static const char metricsPrefix[] = "ssh/devices/metrics/";
+  if (strncmp(topic, metricsPrefix, sizeof(metricsPrefix) - 1) == 0)
+  { // jedyna subskrypcja w tym drzewie to żądanie metryk tego urządzenia
+    publishMetrics();
+    publishDrift();
+    return;
+  }
+  if (strncmp(topic, setPrefix, sizeof(setPrefix) - 1) != 0) return;
+
+  const char* name = topic + sizeof(setPrefix) - 1;
+  bool scene = strcmp(name, "scene") == 0;
+  uint32_t mask = 0;
+  if (strncmp(name, groupPrefix, sizeof(groupPrefix) - 1) == 0)
+  {
+    mask = groupMask(name + sizeof(groupPrefix) - 1);
+    if (mask == 0) return; //grupa bez rolet tego urządzenia
+  }
+  else if (!scene)
+  {
+    int i = blindIndex(name);
+    if (i < 0) return; //roleta innego urządzenia
+    mask = 1u << i;
+  }
+
+  Command_Allocator.reset();
+  JsonDocument doc(&Command_Allocator);
+  DeserializationError error = deserializeJson(doc, payload, length, DeserializationOption::Filter(Command_Filter));
+
+  if (error) {
+    Serial.print("deserializeJson() failed: ");
+    Serial.println(error.c_str());
+    return;
+  }
+
+  double sent = doc["ts"].as<double>(); //opcjonalny czas wysłania w ms (unix, zegar NTP)
+  if (sent > 0)
+  {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int32_t latency = int64_t(now.tv_sec) * 1000 + now.tv_usec / 1000 - int64_t(sent);
+    Mqtt_Latency_Ms = latency;
+    Mqtt_Time.record(int64_t(latency) * 1000);
+    if (latency > Mqtt_Latency_Max_Ms) Mqtt_Latency_Max_Ms = latency;
+  }
 
-  int i = 0;
-  while (token != NULL) 
+  int sets[Blinds_Max];
+  int speeds[Blinds_Max];
+  for (int i=0; i < Blinds_Count; i++)
   {
-    splitTopic[i] = token;
-    i++;
-    token=strtok(NULL, delimiter);
+    sets[i] = -1; //bez zmiany
+    speeds[i] = -1;
   }
 
-  if (splitTopic[0] == "ssh" and splitTopic[1] == "blinds" and splitTopic[2] == "set")
+  if (scene)
   {
-    for (int i = 0; i < Blinds_Count; i++)
+    for (JsonObject item : doc["blinds"].as<JsonArray>())
     {
-      if (String(Blinds_Id[i]) == splitTopic[3])
+      int set = item["set"] | -1;
+      const char* group = item["group"];
+      uint32_t itemMask = group != NULL ? groupMask(group) : 0;
+      if (group == NULL)
       {
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, payload);
-
-        if (error) {
-          Serial.print("deserializeJson() failed: ");
-          Serial.println(error.c_str());
-        }
+        int id = item["id"] | -1;
+        int i = id >= 0 and id < Blinds_Id_Max ? Blinds_Index[id] : -1;
+        if (i >= 0) itemMask = 1u << i;
+      }
+      if (set < 0 or set > 100)
+      {
+        Serial.println("otrzymana wartość nastawienia rolety poza dopuszczalnymi granicami");
+        continue;
+      }
+      for (int i=0; i < Blinds_Count; i++)
+      {
+        if (itemMask & (1u << i)) sets[i] = set;
+      }
+    }
+    applySets(sets, speeds); //sceny bez zmiany prędkości
+    return;
+  }
 
-        // int id = doc["id"];
-        bool calibrate = doc["calibrate"];
-        int set = doc["set"];
-        int speed = doc["speed"];
+  bool calibrate = doc["calibrate"];
+  int set = doc["set"];
+  int speed = doc["speed"];
 
-        if (set < 0 or set > 100)
-        {
-          Serial.println("otrzymana wartość nastawienia rolety poza dopuszczalnymi granicami");
-        }
-        else if (speed < 70 or speed > 100)
-        {
-          Serial.println("otrzymana wartość prędkości rolety poza dopuszczalnymi granicami");
-        }
-        else
-        {
-          Blinds_To_Calibrate[i] = calibrate;
-          Blinds_Set[i] = set;
-
-          // ponieważ aktualnie kontrola położenia obliczana jest przez czas przeazdu
-          // zmiana tej prędkości spowoduje błędy w osiąganiu wymaganej pozycji rolety
-          // być może sens miałoby zaimplementowanie tylko do przejazdów na krańcówki
-          // lub obsługa tylko dwóch czy trzech prędkości
-          // Blinds_Speed_Set[i] = speed;
-        }
-      }
+  if (set < 0 or set > 100)
+  {
+    Serial.println("otrzymana wartość nastawienia rolety poza dopuszczalnymi granicami");
+  }
+  else if (speed < 70 or speed > 100)
+  {
+    Serial.println("otrzymana wartość prędkości rolety poza dopuszczalnymi granicami");
+  }
+  else
+  {
+    for (int i=0; i < Blinds_Count; i++)
+    {
+      if (!(mask & (1u << i))) continue;
+      if (calibrate) Blinds_Calibrate_Request[i]++;
+      sets[i] = set;
+      speeds[i] = speed; //pozycja liczona z prędkości z kalibracji (speedVelocity), więc jazda wolniej trafia w nastawienie
     }
+    applySets(sets, speeds);
   }
 }
 
-void systemStatus(void* parameters)
-{ // przesyłanie przez MQTT informacji o urządzeniu
-  while (true)
+void applySets(const int* sets, const int* speeds)
+{ // nastawienia z jednej wiadomości - silnik ruchu przejmuje je razem, więc rolety ruszają w tym samym ticku
+  Blinds_Set_Batch++; //nieparzysty - zapis w toku; zapisy w serii uporządkowane licznikiem
+  for (int i=0; i < Blinds_Count; i++)
   {
-    if (mqttClient.connected())
-    {
-      time_t now;
-      struct tm timeinfo;
-      if (!getLocalTime(&timeinfo)) {
-        Serial.println("Failed to obtain time");
-      }
-      time(&now);
-
-      sensors.requestTemperatures(); 
-      float temperatureC = sensors.getTempCByIndex(0);
-
-      //TODO stałe dane przesłać do API tylko raz - po połączeniu z WiFi
-    
-      String json = "{\"device\":{\"id\":" + DEVICE_ID 
-      + ",\"name\":\"" + myHostname 
-      + "\",\"type\":\"" + ESP.getChipModel()
-      + "\",\"online\":true"
-      + ",\"temperature:\":" + sensors.getTempCByIndex(0)
-      + "},"
-      + "\"wifi\":{\"ssid\":\"" + WiFi.SSID()
-      + "\",\"hostname\":\"" + myHostname
-      + "\",\"ip\":\"" + WiFi_IP
-      + "\",\"mac\":\"" + WiFi.macAddress()
-      + "\",\"signal\":" + WiFi.RSSI()
-      + "},"
-      + "\"cpu\":{"
-      + "\"cores\":" + ESP.getChipCores() 
-      + ",\"mhz\":" + ESP.getCpuFreqMHz()
-      + ",\"temperature\":" + temperatureRead() 
-      + "},"
-      + "\"meta\":{\"boottime\":" + Boot_Timestamp
-      + ",\"timestamp\":" + now
-      + "}}";
-      // Serial.println(json);
-      
-      String topic = "ssh/devices/status/" + String(DEVICE_ID);
-      int pub = mqttClient.publish(topic.c_str(), json.c_str(), true);
-      if (!pub)
-      {
-        Serial.println("MQTT publish fail!");
-        Serial.println("json size: " + String(json.length()) + " bajts");
-        Serial.println("message buffor: " + String(Mqtt_Buffer_Size));
-      }
-    }
-    vTaskDelay(pdMS_TO_TICKS(60000));
+    if (sets[i] >= 0) Blinds_Set[i].store(sets[i], std::memory_order_relaxed);
+    if (speeds[i] >= 0) Blinds_Speed_Set[i].store(speeds[i], std::memory_order_relaxed);
   }
+  Blinds_Set_Batch++;
+  motionWake(); //silnik ruchu rusza od razu, bez czekania na kolejny tick
 }
 
-void setBlinds(void* parameters)
-{ //nastawianie rolety o -id z parametru w xTaskCreate
-  TaskParams* params = (TaskParams*)parameters;
-  int id = params->param;
-  int delay = 100;
+int blindIndex(const char* id)
+{ // indeks rolety z id w tekście tematu, -1 gdy id nie należy do tego urządzenia
+  char* end;
+  long value = strtol(id, &end, 10);
+  if (end == id or *end != 0 or value < 0 or value >= Blinds_Id_Max) return -1;
+  return Blinds_Index[value];
+}
 
-  while (true)
+uint32_t groupMask(const char* name)
+{ // rolety tego urządzenia w grupie o podanej nazwie, 0 gdy grupy nie ma - tylko zadanie MQTT
+  // pisarz (apiGetConfig) ma niższy priorytet na tym samym rdzeniu - read() czekałby na niego w nieskończoność,
+  // zapis przerwany przez to zadanie zostawia poprzednie grupy do następnego polecenia
+  static BlindGroups groups = {};
+  Blinds_Groups.tryRead(groups);
+  for (int g=0; g < groups.count; g++)
+  {
+    if (strcmp(groups.name[g], name) == 0) return groups.mask[g];
+  }
+  return 0;
+}
+
+void loadGroups(const char* text)
+{ // grupy rolet z tekstu "nazwa:id,id;nazwa:id" (zapis w NVS), tylko rolety tego urządzenia
+  BlindGroups groups = {};
+  const char* p = text;
+  while (*p and groups.count < Groups_Max)
   {
-    if(!Blinds_To_Calibrate[id])
+    const char* colon = strchr(p, ':');
+    if (colon == NULL) break;
+    size_t length = colon - p;
+    uint32_t mask = 0;
+    p = colon + 1;
+    while (*p and *p != ';')
     {
-      if (abs(Blinds_Set[id] - Blinds_Position[id]) > 0.005) // roleta jest na swoim miejscu jeżeli różnica jest <= 0.005% ponieważ float może przeskoczyć równą wartość int
-      {
-        delay = 1;
-        analogWrite(Blinds_Speed_Pin[id], int((Blinds_Speed_Set[id] * 255) / 100));
+      char* end;
+      long id = strtol(p, &end, 10);
+      if (end == p) break;
+      if (id >= 0 and id < Blinds_Id_Max and Blinds_Index[id] >= 0) mask |= 1u << Blinds_Index[id];
+      p = *end == ',' ? end + 1 : end;
+    }
+    if (*p == ';') p++;
+    if (mask == 0 or length == 0 or length >= Group_Name_Size) continue;
+    memcpy(groups.name[groups.count], colon - length, length);
+    groups.mask[groups.count] = mask;
+    groups.count++;
+  }
+  Blinds_Groups.write(groups);
+}
 
-        //TODO jeżeli Blind_Set = 0 lub 100 to nie obliczać pozycji a jechać do krańcówki
+bool validWiring(int id, int chip, int up, int down, int sensorUp, int sensorDown, int speed)
+{ // okablowanie jednej rolety: id, numer układu MCP, cztery różne piny MCP, pin prędkości ESP lub -1
+  // pin prędkości z wyjściem i poza magistralami płytki (halSpeedPinValid) oraz diodą
+  if (id < 0 or id >= Blinds_Id_Max or chip < 0 or chip >= Mcp_Max) return false;
+  if (speed != -1 and (speed == BUILT_LED or !halSpeedPinValid(speed))) return false;
+  int pins[4] = {up, down, sensorUp, sensorDown};
+  uint16_t used = 0;
+  for (int pin : pins)
+  {
+    if (pin < 0 or pin > 15 or (used & (1u << pin))) return false;
+    used |= 1u << pin;
+  }
+  return true;
+}
 
-        //TODO przejazdy poza krańcówki zgodnie z ustawieniami
+bool parseSpeedTable(const char* text, SpeedTable* table)
+{ // kalibracja prędkości "wypełnienie:prędkość,..." w % - wypełnienie rosnąco 1..99, prędkość niemalejąco 0..100,
+  // pusty tekst = prędkość proporcjonalna do wypełnienia
+  memset(table, 0, sizeof(*table));
+  const char* cursor = text;
+  while (*cursor)
+  {
+    int duty, velocity, length;
+    if (table->count == Speed_Table_Max or sscanf(cursor, "%d:%d%n", &duty, &velocity, &length) != 2) return false;
+    int lastDuty = table->count > 0 ? table->duty[table->count - 1] : 0;
+    int lastVelocity = table->count > 0 ? table->velocity[table->count - 1] : 0;
+    if (duty <= lastDuty or duty >= 100 or velocity < lastVelocity or velocity > 100) return false;
+    table->duty[table->count] = duty;
+    table->velocity[table->count] = velocity;
+    table->count++;
+    cursor += length;
+    if (*cursor == ',') cursor++;
+  }
+  return true;
+}
 
-        if (Blinds_Set[id] < Blinds_Position[id])
-        { //podnoszenie rolety
-          if (Blinds_Sensor_Up[id] == 1)
-          {
-            Blinds_Position[id] = 0;
-          }
-          else
-          {
-            Blinds_Move_Up[id] = true;
-            Blinds_Move_Down[id] = false;
-            Blinds_Position[id] = (Blinds_Position[id] * Blinds_Runtime_Up[id] / 100 - 1) / Blinds_Runtime_Up[id] * 100;
-          }
-        }
-        else
-        {
-          if (Blinds_Sensor_Down[id] == 1)
-          {
-            Blinds_Position[id] = 100;
-          }
-          else
-          { //opuszczanie rolety
-            Blinds_Move_Up[id] = false;
-            Blinds_Move_Down[id] = true;
-            Blinds_Position[id] = (Blinds_Position[id] * Blinds_Runtime_Down[id] / 100 + 1) / Blinds_Runtime_Down[id] * 100;
-          }
-        }
-      }
-      else
-      {
-        digitalWrite(Blinds_Speed_Pin[id], LOW);
-        Blinds_Move_Up[id] = false;
-        Blinds_Move_Down[id] = false;
-        Blinds_Position[id] = Blinds_Set[id];
-        delay = 100;
-      }
-    }
-    else
+int parseWiring(const char* text, bool apply)
+{ // okablowanie rolet z tekstu "id:układ:góra:dół:krańcówka_góra:krańcówka_dół:prędkość;..." (zapis w NVS)
+  // zwraca liczbę rolet, 0 gdy tekst jest błędny; apply = zastąpienie bieżącego okablowania
+  int wiring[Blinds_Max][7];
+  bool seen[Blinds_Id_Max] = {};
+  uint64_t speedPins = 0;
+  int count = 0;
+  const char* p = text;
+  while (*p)
+  {
+    if (count == Blinds_Max) return 0;
+    for (int field=0; field < 7; field++)
     {
-      calibrateBlind(id);
+      char* end;
+      wiring[count][field] = strtol(p, &end, 10);
+      char separator = field < 6 ? ':' : ';';
+      if (end == p or (*end != separator and !(field == 6 and *end == 0))) return 0;
+      p = *end ? end + 1 : end;
     }
-    vTaskDelay(pdMS_TO_TICKS(delay));
+    int* w = wiring[count];
+    if (!validWiring(w[0], w[1], w[2], w[3], w[4], w[5], w[6]) or seen[w[0]] or (w[6] >= 0 and (speedPins & (1ull << w[6])))) return 0;
+    seen[w[0]] = true;
+    if (w[6] >= 0) speedPins |= 1ull << w[6];
+    count++;
   }
-  delete params;
-}
+  if (count == 0 or !apply) return count;
 
-void calibrateBlind(int id)
-{ // kalibracja rolety
-  Serial.print("Rozpoczynanie kalibracji rolety nr ");
-  Serial.println(Blinds_Id[id]);
+  memset(Blinds_Index, -1, sizeof(Blinds_Index));
+  Mcp_Count = 1;
+  Mcp_Chips = 0;
+  for (int i=0; i < count; i++)
+  {
+    Blinds_Id[i] = wiring[i][0];
+    Blinds_Chip[i] = wiring[i][1];
+    Mcp_Up_Pin[i] = wiring[i][2];
+    Mcp_Down_Pin[i] = wiring[i][3];
+    Mcp_Sensor_Up_Pin[i] = wiring[i][4];
+    Mcp_Sensor_Down_Pin[i] = wiring[i][5];
+    Blinds_Speed_Pin[i] = wiring[i][6];
+    Blinds_Index[Blinds_Id[i]] = i;
+    Mcp_Count = max(Mcp_Count, Blinds_Chip[i] + 1);
+    Mcp_Chips |= 1u << Blinds_Chip[i];
+  }
+  Blinds_Count = count;
+  return count;
+}
 
-  analogWrite(Blinds_Speed_Pin[id], int((Blinds_Speed_Set[id] * 255) / 100));
+void wiringText(char* text, size_t size)
+{ // bieżące okablowanie w postaci zapisywanej w NVS - porównanie z konfiguracją z API
+  size_t length = 0;
+  text[0] = 0;
+  for (int i=0; i < Blinds_Count and length < size; i++)
+  {
+    length += snprintf(text + length, size - length, "%s%d:%d:%d:%d:%d:%d:%d", i > 0 ? ";" : "",
+      Blinds_Id[i], Blinds_Chip[i], Mcp_Up_Pin[i], Mcp_Down_Pin[i], Mcp_Sensor_Up_Pin[i], Mcp_Sensor_Down_Pin[i], Blinds_Speed_Pin[i]);
+  }
+}
 
-  while (Blinds_Sensor_Up[id] == 0)
+void loadWiring()
+{ // okablowanie z NVS, bez zapisu domyślne z tablic - przed jakimkolwiek użyciem indeksów rolet
+  char wiring[Nvs_String_Size];
+  bool stored = halNvsGetString("wiring", wiring, sizeof(wiring));
+  if (!stored or parseWiring(wiring, true) == 0)
+  {
+    if (stored) Serial.println("Błędne okablowanie rolet w NVS - okablowanie domyślne");
+    memset(Blinds_Index, -1, sizeof(Blinds_Index));
+    for (int i=0; i < Blinds_Count; i++)
+    {
+      Blinds_Index[Blinds_Id[i]] = i;
+    }
+  }
+  for (int i=0; i < Blinds_Max; i++)
   {
-    Blinds_Move_Up[id] = true;
-    vTaskDelay(pdMS_TO_TICKS(1));
+    Blinds_Speed_Set[i] = 100;
+    Blinds_Motion[i].speed = 100;
+    Blinds_Motion[i].drift = NAN;
   }
-  Blinds_Move_Up[id] = false;
+}
 
-  int stepsDown = 0;
+void startBoard()
+{ // konfiguracja pinów wszystkich układów MCP według okablowania i start zadania mcpLoop
+  halSpeedBegin(Pwm_Frequency, Pwm_Resolution);
+  for (int chip=0; chip < Mcp_Count; chip++)
+  {
+    if (!(Mcp_Chips & (1u << chip))) continue;
+    if (!halMcpBegin(chip)) {
+      Serial.printf("MCP23017 0x%02X Error\n", 0x20 + chip);
+      while (true);
+    }
+  }
 
-  while (Blinds_Sensor_Down[id] == 0)
+  for (int i=0; i < Blinds_Count; i++)
   {
-    Blinds_Move_Down[id] = true;
-    vTaskDelay(pdMS_TO_TICKS(1));
-    ++stepsDown;
+    uint8_t chip = Blinds_Chip[i];
+    halMcpPinMode(chip, Mcp_Up_Pin[i], OUTPUT);
+    halMcpDigitalWrite(chip, Mcp_Up_Pin[i], HIGH);
+    halMcpPinMode(chip, Mcp_Down_Pin[i], OUTPUT);
+    halMcpDigitalWrite(chip, Mcp_Down_Pin[i], HIGH);
+    halMcpPinMode(chip, Mcp_Sensor_Up_Pin[i], INPUT);
+    halMcpPinMode(chip, Mcp_Sensor_Down_Pin[i], INPUT);
+    if (Blinds_Speed_Pin[i] >= 0 and !halSpeedPinInit(Blinds_Speed_Pin[i]))
+    { //przekaźnik bez PWM nie poruszy silnika, a model liczyłby jazdę - roleta wyłączona do zmiany okablowania
+      Serial.printf("Brak kanału PWM na pinie %d - roleta nr %d wyłączona\n", Blinds_Speed_Pin[i], Blinds_Id[i]);
+      Blinds_Disabled[i] = true;
+    }
   }
-  Blinds_Move_Down[id] = false;
-  
-  int stepsUp = 0;
+  Board_Started = true;
+
+  xTaskCreatePinnedToCore(
+    mcpLoop,           // Function that should be called
+    "MCP Read Write",  // Name of the task (for debugging)
+    3000,              // Stack size (bytes)
+    NULL,              // Parameter to pass
+    Mcp_Priority,      // Task priority
+    &Mcp_Task,         // Task handle
+    App_Core           // Core - razem z silnikiem ruchu
+  );
+  registerTask(Mcp_Task, 3000);
+}
 
-  while (Blinds_Sensor_Up[id] == 0)
+void publishDescriptor()
+{ // stałe informacje o urządzeniu - raz na połączenie MQTT, wiadomość zachowana na brokerze do czasu willMessage
+  static char json[Descriptor_Json_Size]; //wywoływane tylko z connectMqtt
+  char topic[40];
+  snprintf(topic, sizeof(topic), "ssh/devices/status/%s", DEVICE_ID.c_str());
+  int length = snprintf(json, sizeof(json),
+    "{\"device\":{\"id\":%s,\"name\":\"%s\",\"type\":\"%s\",\"online\":true},"
+    "\"wifi\":{\"ssid\":\"%s\",\"hostname\":\"%s\",\"ip\":\"%s\",\"mac\":\"%s\"},"
+    "\"cpu\":{\"cores\":%u,\"mhz\":%u},"
+    "\"meta\":{\"boottime\":%d,\"boot_ms\":%d}}",
+    DEVICE_ID.c_str(), myHostname.c_str(), ESP.getChipModel(),
+    WiFi_SSID, myHostname.c_str(), WiFi_IP, WiFi_Mac,
+    (unsigned)ESP.getChipCores(), (unsigned)ESP.getCpuFreqMHz(),
+    Boot_Timestamp, (int)Boot_Ready_Ms);
+
+  if (length >= (int)sizeof(json) or !halMqttPublish(topic, json, true))
   {
-    Blinds_Move_Up[id] = true;
-    vTaskDelay(pdMS_TO_TICKS(1));
-    ++stepsUp;
+    Serial.println("MQTT publish fail!");
+    Serial.printf("json size: %d bajts\n", length);
   }
-  digitalWrite(Blinds_Speed_Pin[id], LOW);
+}
 
-  Blinds_Position[id] = 0;
-  Blinds_Runtime_Up[id] = stepsUp;
-  Blinds_Runtime_Down[id] = stepsDown;
-  
+void temperatureLoop(void* parameters)
+{ // pomiar DS18B20 bez blokowania - konwersja startuje w jednym ticku, wynik odbierany w kolejnym
+  bool converting = false;
   while (true)
   {
-    vTaskDelay(pdMS_TO_TICKS(10));
-    if(WiFi.status() == WL_CONNECTED)
+    if (converting and halTempReady())
     {
-      String url = API_URL + "/blinds/" + String(Blinds_Id[id]) + "/";
-      String payload = "{\"position\":0, \"runtime_up\": " + String(Blinds_Runtime_Up[id]) + ", \"runtime_down\": " + String(Blinds_Runtime_Down[id]) + "}";
-
-      HTTPClient httpClient;
-      httpClient.begin(url);
-      httpClient.addHeader("Content-Type", "application/json");
-      httpClient.addHeader("Authorization", "Bearer " + accessToken);
-      int httpResponseCode = httpClient.PATCH(payload);
-
-      if (httpResponseCode > 0) 
-      {
-        if (httpResponseCode == 200)
-        {
-          String response = httpClient.getString();
-          // Serial.println(response);
-          httpClient.end();
-          Blinds_To_Calibrate[id] = false;
-          // Serial.println("PATCH success");
-          vTaskDelay(pdMS_TO_TICKS(200));
-          break;
-        }
-        else
-        {
-          Serial.print("API Error code: ");
-          Serial.println(httpResponseCode);
-        }
-      }
-      else
+      for (int i=0; i < Temp_Count; i++)
       {
-        Serial.print("API Error on sending PATCH: ");
-        Serial.println(httpResponseCode);
+        Temperatures[i] = halTempC(i);
       }
-      httpClient.end();
+      converting = false;
     }
-    else
+    if (!converting and Temp_Count > 0)
     {
-      connectWiFi();
+      halTempRequest();
+      converting = true;
     }
-    vTaskDelay(pdMS_TO_TICKS(10));
+    vTaskDelay(pdMS_TO_TICKS(Temp_Sample_Ms));
   }
-
-  Serial.print("Wyniki kalibracji rolety nr ");
-  Serial.print(Blinds_Id[id]);
-  Serial.println(":");
-  Serial.print("Przejazd w dół: ");
-  Serial.println(stepsDown);
-  Serial.print("Przejazd w górę: ");
-  Serial.println(stepsUp);
 }
 
-void publishBlinds(void* parameters)
-{ //publikowanie o zmianie położenia rolet
-  int old_Blinds_Position[4] = {};
+float sensorTemperature(int index)
+{ // ostatni odczyt czujnika z pamięci, bez dostępu do magistrali - dla telemetrii i zabezpieczeń silników
+  if (index < 0 or index >= Temp_Count) return Temp_Disconnected;
+  return Temperatures[index];
+}
 
-  for (int i=0; i < Blinds_Count; i++)
-  {
-    old_Blinds_Position[i] = Blinds_Position[i];
-  }
+void systemStatus(void* parameters)
+{ // telemetria urządzenia przez MQTT - tylko wartości zmienne, wysyłane po przekroczeniu progów lub co Telemetry_Heartbeat_Ms
+  static char json[Status_Json_Size]; //bufor zadania - komunikat budowany bez sterty
+  char topic[40];
+  snprintf(topic, sizeof(topic), "ssh/devices/telemetry/%s", DEVICE_ID.c_str());
+  long sentRssi = 0;
+  float sentTemperature = 0;
+  float sentCpuTemperature = 0;
+  uint32_t sentHeap = 0;
+  TickType_t sentAt = 0;
 
   while (true)
   {
-    if (mqttClient.connected())
+    if (halMqttConnected())
     {
-      for (int i=0; i < Blinds_Count; i++)
+      float temperatureC = sensorTemperature(0);
+      float cpuTemperature = temperatureRead();
+      long rssi = halWiFiRSSI();
+      uint32_t heapFree = halHeapFree();
+
+      bool due = Telemetry_Force.exchange(false)
+        or abs(rssi - sentRssi) >= Telemetry_Rssi_Delta
+        or fabs(temperatureC - sentTemperature) >= Telemetry_Temperature_Delta
+        or fabs(cpuTemperature - sentCpuTemperature) >= Telemetry_Temperature_Delta
+        or max(heapFree, sentHeap) - min(heapFree, sentHeap) >= Telemetry_Heap_Delta
+        or xTaskGetTickCount() - sentAt >= pdMS_TO_TICKS(Telemetry_Heartbeat_Ms);
+
+      if (due)
       {
-        if (old_Blinds_Position[i] != int(Blinds_Position[i]))
+        time_t now;
+        time(&now);
+        int length = snprintf(json, sizeof(json),
+          "{\"device\":{\"id\":%s,\"temperature\":%.2f},"
+          "\"wifi\":{\"signal\":%ld},"
+          "\"cpu\":{\"temperature\":%.2f},"
+          "\"heap\":{\"free\":%u,\"largest\":%u},"
+          "\"mcp\":{\"i2c_tps\":%u},"
+          "\"api\":{\"connections\":%u},"
+          "\"mqtt\":{\"latency_ms\":%d,\"latency_max_ms\":%d},"
+          "\"meta\":{\"uptime\":%lu,\"timestamp\":%ld}}",
+          DEVICE_ID.c_str(), temperatureC,
+          rssi,
+          cpuTemperature,
+          (unsigned)heapFree, (unsigned)halHeapLargestFreeBlock(),
+          (unsigned)Mcp_I2C_Rate,
+          (unsigned)halHttpConnections(),
+          (int)Mqtt_Latency_Ms, (int)Mqtt_Latency_Max_Ms,
+          millis() / 1000, (long)now);
+
+        if (length < (int)sizeof(json) and halMqttPublish(topic, json, true))
         {
-          old_Blinds_Position[i] = int(Blinds_Position[i]);
-          String topic = "ssh/blinds/run/" + String(Blinds_Id[i]);
-          String messageString = "{\"id\": " + String(Blinds_Id[i]) + ", \"set\": " + Blinds_Set[i] + ", \"step\": " + int(Blinds_Position[i]) + "}";
-          // Serial.println(messageString);
-
-          int pub = mqttClient.publish(topic.c_str(), messageString.c_str(), true); //wysłanie informacji o zmienie pozycji rolety
-          if (!pub)
-          {
-            Serial.println("MQTT publish fail!");
-          }
-          vTaskDelay(pdMS_TO_TICKS(10));
+          Mqtt_Latency_Max_Ms = -1;
+          sentRssi = rssi;
+          sentTemperature = temperatureC;
+          sentCpuTemperature = cpuTemperature;
+          sentHeap = heapFree;
+          sentAt = xTaskGetTickCount();
+        }
+        else
+        {
+          Telemetry_Force = true; //ponowienie przy kolejnym odczycie
+          Serial.println("MQTT publish fail!");
+          Serial.printf("json size: %d bajts\n", length);
         }
       }
     }
-    vTaskDelay(pdMS_TO_TICKS(100));
+    vTaskDelay(pdMS_TO_TICKS(Telemetry_Sample_Ms));
   }
 }
 
-void mcpLoop(void* parameters)
-{ // funkcja ustawiająca MCP23017 zgodnie ze zmiennymi
-  // utworzone w ten sposób aby tylko pojedyncze zadanie komunikowało się z MCP
-  while (true)
+void registerTask(TaskHandle_t handle, uint32_t stack)
+{ // zadanie w metrykach stosu - wpis zajmowany atomowo, zadania startują z setup i z apiSync
+  if (handle == NULL) return;
+  int slot = Tasks_Count.fetch_add(1);
+  if (slot >= Tasks_Max) return;
+  TaskEntry& entry = Tasks[slot];
+  strncpy(entry.name, pcTaskGetName(handle), sizeof(entry.name) - 1);
+  entry.stack = stack;
+  entry.handle = handle;
+  entry.ready = true;
+}
+
+void taskFinished()
+{ // zużycie stosu zadania zapamiętane przed vTaskDelete(NULL) - uchwyt usuniętego zadania jest nieważny
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  int count = min(Tasks_Count.load(), Tasks_Max);
+  for (int i=0; i < count; i++)
   {
-    for (int i=0; i < Blinds_Count; i++)
+    if (Tasks[i].ready and Tasks[i].handle == self)
     {
-      Blinds_Sensor_Up[i] = mcp.digitalRead(Mcp_Sensor_Up_Pin[i]);
-      Blinds_Sensor_Down[i] = mcp.digitalRead(Mcp_Sensor_Down_Pin[i]);
-      mcp.digitalWrite(Mcp_Up_Pin[i], Blinds_Move_Up[i]);
-      mcp.digitalWrite(Mcp_Down_Pin[i], Blinds_Move_Down[i]);
+      Tasks[i].freeAtExit = uxTaskGetStackHighWaterMark(NULL);
+      Tasks[i].handle = NULL;
     }
-    vTaskDelay(pdMS_TO_TICKS(1));
   }
 }
 
-void apiUpdatePosition(void* parameters)
-{ // przesyłanie aktualizacji pozycji rolet do API
-  float Blinds_Api_Position[Blinds_Count] = {};
+void publishMetrics()
+{ // metryki na żądanie: najmniejszy wolny stos zadań, obciążenie rdzeni od poprzedniego żądania,
+  // histogramy czasów w us od uruchomienia (wywoływane z callback - zadanie MQTT)
+  static char json[Metrics_Json_Size];
+  const int size = sizeof(json);
+  char topic[40];
+  snprintf(topic, sizeof(topic), "ssh/devices/metrics/%s", DEVICE_ID.c_str());
+  int length = snprintf(json, size, "{\"device\":{\"id\":%s,\"uptime\":%lu},\"tasks\":[", DEVICE_ID.c_str(), millis() / 1000);
+
+  int count = min(Tasks_Count.load(), Tasks_Max);
+  bool first = true;
+  for (int i=0; i < count and length < size; i++)
+  {
+    TaskEntry& entry = Tasks[i];
+    if (!entry.ready) continue;
+    TaskHandle_t handle = entry.handle;
+    uint32_t stackFree = handle != NULL ? uxTaskGetStackHighWaterMark(handle) : entry.freeAtExit;
+    length += snprintf(json + length, size - length, "%s{\"name\":\"%s\",\"stack\":%u,\"free\":%u%s}",
+      first ? "" : ",", entry.name, (unsigned)entry.stack, (unsigned)stackFree, handle != NULL ? "" : ",\"finished\":true");
+    first = false;
+  }
+
+  for (int core=0; core < ESP.getChipCores() and length < size; core++)
+  {
+    length += snprintf(json + length, size - length, "%s%.1f", core == 0 ? "],\"cpu\":[" : ",", halCpuLoad(core));
+  }
+
+  const char* names[] = {
+    "],\"motion\":{\"period\":", ",\"jitter\":", ",\"busy\":",
+    "},\"mcp\":{\"period\":", ",\"jitter\":", ",\"busy\":", ",\"i2c\":",
+    "},\"api\":{\"http\":", "},\"mqtt\":{\"latency\":"};
+  const Histogram* histograms[] = {
+    &Motion_Metrics.period, &Motion_Metrics.jitter, &Motion_Metrics.busy,
+    &Mcp_Metrics.period, &Mcp_Metrics.jitter, &Mcp_Metrics.busy, &I2c_Time,
+    &Http_Time, &Mqtt_Time};
+  for (int i=0; i < 9 and length < size; i++)
+  {
+    length += snprintf(json + length, size - length, "%s", names[i]);
+    if (length < size) length += histograms[i]->format(json + length, size - length);
+  }
+  if (length < size) length += snprintf(json + length, size - length, "}}");
+
+  if (length >= size or !halMqttPublish(topic, json, false))
+  {
+    Serial.println("MQTT publish fail!");
+    Serial.printf("json size: %d bajts\n", length);
+  }
+}
 
+void publishDrift()
+{ // dryf rolet od uruchomienia - po wiadomości na roletę w ssh/devices/metrics/<id>/drift/<id rolety>, rozmiar niezależny od liczby rolet:
+  // korekty na krańcówkach, jazdy bez krańcówki, ostatni błąd, średni i największy |błąd| w %
+  char topic[48];
+  char json[128];
   for (int i=0; i < Blinds_Count; i++)
   {
-    Blinds_Api_Position[i] = Blinds_Position[i];
+    BlindSnapshot snapshot = Blinds_State[i].read();
+    char last[12] = "null";
+    if (!isnan(snapshot.drift)) snprintf(last, sizeof(last), "%.2f", snapshot.drift);
+    snprintf(topic, sizeof(topic), "ssh/devices/metrics/%s/drift/%d", DEVICE_ID.c_str(), Blinds_Id[i]);
+    int length = snprintf(json, sizeof(json), "{\"id\":%d,\"homings\":%u,\"missed\":%u,\"last\":%s,\"mean\":%.2f,\"max\":%.2f}",
+      Blinds_Id[i], (unsigned)snapshot.homings, (unsigned)snapshot.missed, last,
+      snapshot.homings > 0 ? snapshot.driftSum / snapshot.homings : 0.0f, snapshot.driftMax);
+    if (length >= (int)sizeof(json) or !halMqttPublish(topic, json, false))
+    {
+      Serial.println("MQTT publish fail!");
+      Serial.printf("json size: %d bajts\n", length);
+    }
   }
+}
 
+void motionLoop(void* parameters)
+{ // silnik ruchu na rdzeniu aplikacyjnym - tick co Motion_Tick_Us, gdy któraś roleta pracuje, poza tym uśpienie do wybudzenia
+  // okres odmierzany tickami FreeRTOS (przerwanie), a nie zadaniem esp_timer, które w Arduino-ESP32 jest przypięte
+  // do rdzenia 0 i czeka tam na WiFi
+  const TickType_t period = pdMS_TO_TICKS(Motion_Tick_Us / 1000);
+  TickType_t due = 0; //tick FreeRTOS kolejnego ticku silnika
+  bool running = false; //któraś roleta pracuje - ticki okresowe
   while (true)
   {
-    for (int i=0; i < Blinds_Count; i++)
+    TickType_t wait = portMAX_DELAY;
+    if (running)
     {
-      if (Blinds_Api_Position[i] != Blinds_Position[i] and Blinds_Set[i] == Blinds_Position[i])
-      {
-        if(WiFi.status() == WL_CONNECTED)
+      TickType_t ticks = xTaskGetTickCount();
+      wait = int32_t(due - ticks) > 0 ? due - ticks : 0;
+    }
+    bool woken = ulTaskNotifyTake(pdTRUE, wait) > 0; //powiadomienia się sumują - wybudzenie w trakcie ticku nie ginie
+
+    int64_t now = esp_timer_get_time();
+    int64_t last = Motion_Metrics.lastStart();
+    Motion_Metrics.begin(now, running and !woken and last >= 0 ? last + Motion_Tick_Us : -1);
+    bool active = motionTick(now);
+    Motion_Metrics.end(esp_timer_get_time());
+
+    TickType_t ticks = xTaskGetTickCount();
+    if (!active)
+    {
+      running = false;
+      Motion_Metrics.pause(); //kolejny tick po wybudzeniu - bez pomiaru okresu
+    }
+    else if (!running)
+    {
+      running = true;
+      due = ticks + period;
+    }
+    else
+    {
+      while (int32_t(due - ticks) <= 0) due += period; //stała faza ticków, spóźniony tick nie przesuwa kolejnych
+    }
+  }
+}
+
+bool motionTick(int64_t now)
+{ // silnik ruchu wszystkich rolet, zwraca true, jeżeli któraś roleta potrzebuje kolejnych ticków
+  // pozycja liczona z czasu pracy silnika od chwili startu (esp_timer_get_time), a nie z liczby ticków
+  uint16_t inputs[Mcp_Max]; //jeden odczyt krańcówek na tick
+  uint16_t outputs[Mcp_Max];
+  uint16_t passes[Mcp_Max];
+  for (int chip=0; chip < Mcp_Count; chip++)
+  {
+    inputs[chip] = Mcp_Inputs[chip];
+    outputs[chip] = Mcp_Requested[chip];
+    passes[chip] = Mcp_Pass[chip];
+  }
+  bool active = false;
+  bool events = false;
+
+  uint32_t batch = Blinds_Set_Batch;
+  if (!(batch & 1))
+  { // nastawienia z wiadomości zapisywanej w trakcie tego ticku przejmie kolejny tick (callback wybudza silnik po zapisie)
+    int sets[Blinds_Max];
+    int speeds[Blinds_Max];
+    for (int i=0; i < Blinds_Count; i++)
+    {
+      sets[i] = Blinds_Set[i].load(std::memory_order_relaxed);
+      speeds[i] = Blinds_Speed_Set[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire); //odczyty serii przed ponownym odczytem licznika
+    if (batch == Blinds_Set_Batch)
+    {
+      for (int i=0; i < Blinds_Count; i++)
+      {
+        Blinds_Motion[i].set = sets[i];
+        Blinds_Motion[i].speed = speeds[i];
+      }
+    }
+  }
+
+  for (int i=0; i < Blinds_Count; i++)
+  {
+    if (Blinds_Disabled[i]) continue;
+    bool blindActive = motionStep(i, now, inputs);
+    if (applyApiTimings(i) and Api_Task != NULL)
+    {
+      xTaskNotifyGive(Api_Task); //czasy z API do zapisu w NVS
+    }
+    setPass(i);
+    publishState(i);
+    journalUpdate(i, now);
+    events |= queueBlindEvent(i, now, inputs);
+    if (Blinds_Motion[i].active and !blindActive and Api_Task != NULL)
+    {
+      xTaskNotifyGive(Api_Task); //roleta zatrzymana - pozycja do kolejki API
+    }
+    Blinds_Motion[i].active = blindActive;
+    active |= blindActive or Blinds_Motion[i].eventRetry; //ponowienie zdarzenia także po zatrzymaniu rolety
+  }
+  bool changed = false;
+  for (int chip=0; chip < Mcp_Count; chip++)
+  {
+    changed |= Mcp_Requested[chip] != outputs[chip] or Mcp_Pass[chip] != passes[chip];
+  }
+  if (changed and Mcp_Task != NULL)
+  {
+    mcpWakeMark();
+    xTaskNotifyGive(Mcp_Task); //wszystkie przekaźniki z tego ticku w jednym zapisie GPIOAB na układ
+  }
+  if (events and Publish_Task != NULL)
+  {
+    xTaskNotifyGive(Publish_Task);
+  }
+  return active;
+}
+
+void motionWake()
+{ // natychmiastowy tick silnika ruchu - nastawienie z callback zapisane w trakcie ticku obsłuży kolejny tick
+  if (Motion_Task != NULL)
+  {
+    xTaskNotifyGive(Motion_Task);
+  }
+}
+
+void publishState(int id)
+{ // udostępnienie stanu rolety czytelnikom (publishBlinds, apiUpdatePosition)
+  BlindSnapshot snapshot;
+  snapshot.position = Blinds_Motion[id].position;
+  snapshot.set = Blinds_Set[id];
+  snapshot.runtimeUp = Blinds_Runtime_Up[id];
+  snapshot.runtimeDown = Blinds_Runtime_Down[id];
+  snapshot.passUp = Blinds_Pass_Up[id];
+  snapshot.passDown = Blinds_Pass_Down[id];
+  snapshot.calibrations = Blinds_Motion[id].calibrations;
+  snapshot.homings = Blinds_Motion[id].homings;
+  snapshot.missed = Blinds_Motion[id].missed;
+  snapshot.drift = Blinds_Motion[id].drift;
+  snapshot.driftSum = Blinds_Motion[id].driftSum;
+  snapshot.driftMax = Blinds_Motion[id].driftMax;
+  Blinds_State[id].write(snapshot);
+}
+
+void journalUpdate(int id, int64_t now)
+{ // stan rolety do dziennika: zmiana kierunku lub nastawienia od razu, pozycja jadącej rolety co Journal_Checkpoint_Ms
+  BlindMotion& motion = Blinds_Motion[id];
+  JournalEntry entry = {};
+  entry.position = lroundf(motion.position * 100);
+  entry.blind = Blinds_Id[id];
+  entry.direction = motion.direction;
+  entry.target = motion.direction != 0 ? motion.target : lroundf(motion.position);
+  entry.calibrating = motion.state == BLIND_CALIBRATING;
+
+  const JournalEntry& last = motion.journal;
+  bool changed = entry.direction != last.direction or entry.target != last.target or entry.calibrating != last.calibrating;
+  bool moved = entry.position != last.position and (entry.direction == 0 or now - motion.journalTime >= Journal_Checkpoint_Ms * 1000LL);
+  if (!changed and !moved) return;
+
+  motion.journal = entry;
+  motion.journalTime = now;
+  Journal_State[id].write(entry);
+  if (Journal_Task != NULL)
+  {
+    xTaskNotifyGive(Journal_Task);
+  }
+}
+
+bool queueBlindEvent(int id, int64_t now, const uint16_t* inputs)
+{ // zdarzenie dla publishBlinds po kroku rolety: start (także zmiana kierunku, nastawienia lub prędkości w trakcie jazdy),
+  // stop (na krańcówce - endstop) i zmiana pozycji o pełny %; zwraca true, jeżeli powstało zdarzenie
+  BlindMotion& motion = Blinds_Motion[id];
+  int step = int(motion.position);
+  BlindEvent event;
+  if (motion.direction != motion.eventDirection and motion.direction != 0)
+  {
+    event.type = BLIND_EVENT_START;
+  }
+  else if (motion.direction != motion.eventDirection)
+  {
+    bool endstop = motion.eventDirection < 0 ? sensorUp(id, inputs) : sensorDown(id, inputs);
+    event.type = endstop ? BLIND_EVENT_ENDSTOP : BLIND_EVENT_STOP;
+  }
+  else if (motion.direction != 0 and (motion.set != motion.eventSet or motion.speed != motion.eventSpeed))
+  { //nowe nastawienie lub prędkość w trakcie jazdy - nowy czas dojazdu
+    event.type = BLIND_EVENT_START;
+  }
+  else if (step != motion.eventStep)
+  { //pozycja stojącej rolety zmieniona poza jazdą (koniec kalibracji, odtworzenie) - publikacja od razu jak stop
+    event.type = motion.direction != 0 ? BLIND_EVENT_PROGRESS : BLIND_EVENT_STOP;
+  }
+  else
+  {
+    return false;
+  }
+  event.blind = id;
+  event.set = motion.set;
+  event.direction = motion.direction;
+  event.target = motion.state == BLIND_CALIBRATING ? (motion.direction < 0 ? 0 : 100) : motion.target;
+  event.speed = motion.state == BLIND_CALIBRATING ? 100 : motion.speed;
+  event.position = motion.position;
+  event.drift = motion.drift;
+  event.time = now;
+  motion.eventRetry = !Blinds_Events.push(event);
+  if (motion.eventRetry)
+  { //stan ostatniego zdarzenia bez zmian - start lub stop ponowiony w kolejnym ticku, a wiadomość ruchu nie utknie
+    // na starym zamiarze; eventDirection zostaje prawdziwym kierunkiem jazdy dla rozpoznania krańcówki przy stopie
+    Blinds_Events_Lost.fetch_or(1u << id);
+    return true;
+  }
+  motion.eventDirection = motion.direction;
+  motion.eventStep = step;
+  motion.eventSet = motion.set;
+  motion.eventSpeed = motion.speed;
+  return true;
+}
+
+bool sensorUp(int id, const uint16_t* inputs)
+{ // inputs - odczyty GPIOAB wszystkich układów MCP
+  return (inputs[Blinds_Chip[id]] >> Mcp_Sensor_Up_Pin[id]) & 1;
+}
+
+bool sensorDown(int id, const uint16_t* inputs)
+{
+  return (inputs[Blinds_Chip[id]] >> Mcp_Sensor_Down_Pin[id]) & 1;
+}
+
+bool motionStep(int id, int64_t now, const uint16_t* inputs)
+{ // krok maszyny stanów rolety, zwraca true, jeżeli roleta potrzebuje kolejnych ticków
+  BlindMotion& motion = Blinds_Motion[id];
+  int set = motion.set;
+
+  uint32_t calibrateRequest = Blinds_Calibrate_Request[id];
+  if (calibrateRequest != motion.calibrateHandled and motion.state != BLIND_CALIBRATING)
+  {
+    Serial.print("Rozpoczynanie kalibracji rolety nr ");
+    Serial.println(Blinds_Id[id]);
+    motion.calibrateHandled = calibrateRequest;
+    motion.state = BLIND_CALIBRATING;
+    motion.phase = 0;
+    startMotor(id, -1, now);
+  }
+
+  if (motion.state == BLIND_CALIBRATING)
+  {
+    return calibrationStep(id, now, inputs);
+  }
+
+  if (motion.state == BLIND_PASS)
+  { //docisk za krańcówką - przejechana odległość odrobiona na początku kolejnej jazdy
+    int pass = motion.direction < 0 ? Blinds_Pass_Up[id] : Blinds_Pass_Down[id];
+    if (set == motion.target and now - motion.moveStart < int64_t(pass) * 1000)
+    {
+      return true;
+    }
+    motion.beyond = motion.direction * travelDistance(id, motion.direction, motion.velocity, now - motion.segmentStart);
+    stopMotor(id);
+  }
+
+  if (motion.state == BLIND_UP or motion.state == BLIND_DOWN or motion.state == BLIND_OVERTRAVEL)
+  { //pozycja z modelu bez ograniczenia do 0..100 - przy szukaniu krańcówki wychodzi poza zakres
+    float estimate = motion.startPosition + motion.direction * travelDistance(id, motion.direction, motion.velocity, now - motion.segmentStart);
+    motion.position = min(100.0f, max(0.0f, estimate));
+    speedStep(id, now);
+    bool endstop = motion.direction < 0 ? sensorUp(id, inputs) : sensorDown(id, inputs);
+    if (endstop)
+    { //każda krańcówka w kierunku jazdy koryguje pozycję
+      homeBlind(id, motion.direction, estimate, now, true);
+      return true;
+    }
+
+    if (motion.state == BLIND_OVERTRAVEL)
+    {
+      float searched = motion.direction < 0 ? -estimate : estimate - 100;
+      if (set == motion.target and searched < Endstop_Search_Percent)
+      {
+        return true;
+      }
+      if (set == motion.target)
+      {
+        motion.missed++;
+        Serial.printf("Roleta nr %d bez krańcówki %.1f%% za pozycją krańcową\n", Blinds_Id[id], searched);
+      }
+      stopMotor(id);
+    }
+    else if (motion.target == set and (motion.direction < 0 ? motion.position <= motion.target + 0.005 : motion.position >= motion.target - 0.005))
+    { //ta sama tolerancja co niżej - inaczej roleta 0.005% przed krańcową pozycją staje bez dojazdu do krańcówki
+      motion.position = motion.target; //nastawienie osiągnięte lub minięte w trakcie ostatniego ticka
+      if (motion.target == 0 or motion.target == 100)
+      { //pozycja krańcowa osiągnięta z modelu - pełne otwarcie i zamknięcie zawsze dojeżdża do krańcówki
+        motion.state = BLIND_OVERTRAVEL;
+        return true;
+      }
+    }
+  }
+
+  if (abs(set - motion.position) > 0.005) // roleta jest na swoim miejscu jeżeli różnica jest <= 0.005% ponieważ float może przeskoczyć równą wartość int
+  {
+    int wanted = set < motion.position ? -1 : 1;
+    motion.target = set;
+
+    if (wanted < 0 and sensorUp(id, inputs))
+    { //roleta już na górnej krańcówce
+      homeBlind(id, -1, motion.position, now, false);
+    }
+    else if (wanted > 0 and sensorDown(id, inputs))
+    { //roleta już na dolnej krańcówce
+      homeBlind(id, 1, motion.position, now, false);
+    }
+    else if (wanted != motion.direction)
+    {
+      startMotor(id, wanted, now);
+    }
+    return true;
+  }
+
+  if (motion.state != BLIND_IDLE)
+  {
+    stopMotor(id);
+  }
+  motion.position = set;
+  return false;
+}
+
+bool calibrationStep(int id, int64_t now, const uint16_t* inputs)
+{ // kalibracja: dojazd do górnej krańcówki, pomiar czasu przejazdu w dół i w górę
+  // koniec przejazdu sygnalizuje mcpLoop (przerwanie krańcówki)
+  BlindMotion& motion = Blinds_Motion[id];
+  bool endstop = motion.direction < 0 ? sensorUp(id, inputs) : sensorDown(id, inputs);
+  if (!endstop)
+  {
+    return true;
+  }
+
+  if (motion.phase == 0)
+  {
+    motion.phase = 1;
+    startMotor(id, 1, now);
+  }
+  else if (motion.phase == 1)
+  {
+    Blinds_Runtime_Down[id] = (now - motion.moveStart) / 1000;
+    motion.phase = 2;
+    startMotor(id, -1, now);
+  }
+  else
+  {
+    Blinds_Runtime_Up[id] = (now - motion.moveStart) / 1000;
+    stopMotor(id);
+    motion.position = 0;
+    motion.homed = -1;
+    motion.calibrations++; //wyniki wysyła apiUpdatePosition - silnik ruchu nie może czekać na HTTP
+  }
+  return true;
+}
+
+void startMotor(int id, int direction, int64_t now)
+{ // start silnika lub zmiana kierunku - nowy punkt odniesienia dla pozycji
+  // kalibracja zawsze z pełnym wypełnieniem i bez rampy - mierzy czasy przejazdu, do których odnosi się prędkość
+  BlindMotion& motion = Blinds_Motion[id];
+  motion.fullTravel = motion.homed == -direction and (Blinds_Speed_Pin[id] < 0 or motion.speed == 100);
+  motion.homed = 0;
+  motion.drift = NAN;
+  motion.direction = direction;
+  motion.moveStart = now;
+  motion.segmentStart = now;
+  motion.startPosition = motion.position + motion.beyond;
+  motion.beyond = 0;
+  bool calibrating = motion.state == BLIND_CALIBRATING;
+  if (!calibrating)
+  {
+    motion.state = direction < 0 ? BLIND_UP : BLIND_DOWN;
+  }
+  motion.duty = calibrating ? 100 : Speed_Ramp_Ms > 0 ? 0 : motion.speed;
+  motion.velocity = speedVelocity(id, motion.duty);
+  if (Blinds_Speed_Pin[id] >= 0) halSpeedWrite(Blinds_Speed_Pin[id], motion.duty / 100);
+  setMotor(id, direction < 0, direction > 0);
+}
+
+void stopMotor(int id)
+{
+  BlindMotion& motion = Blinds_Motion[id];
+  motion.state = BLIND_IDLE;
+  motion.direction = 0;
+  motion.duty = 0;
+  if (Blinds_Speed_Pin[id] >= 0) halSpeedWrite(Blinds_Speed_Pin[id], 0);
+  setMotor(id, false, false);
+}
+
+bool applyApiTimings(int id)
+{ // czasy przejazdu i pass odczytane z API (apiGetBlinds) przejmowane na postoju rolety - bez zmiany skali w trakcie jazdy
+  // czasy przejazdu zmienione lokalnie po ostatnim potwierdzeniu API (kalibracja, korekta na krańcówce) są nowsze - wyśle je
+  // apiUpdatePosition; zwraca true, jeżeli wartości z API zostały przejęte
+  BlindMotion& motion = Blinds_Motion[id];
+  uint32_t request = Blinds_Api_Timings_Request[id];
+  if (request == motion.timingsHandled or motion.state != BLIND_IDLE) return false;
+  motion.timingsHandled = request;
+  BlindTimings timings = Blinds_Api_Timings[id].read();
+  Blinds_Pass_Up[id] = timings.passUp;
+  Blinds_Pass_Down[id] = timings.passDown;
+  if (motion.calibrations != timings.confirmed)
+  {
+    Serial.printf("Roleta nr %d: czasy przejazdu z API starsze niż lokalne - pominięte\n", Blinds_Id[id]);
+    return true;
+  }
+  Blinds_Runtime_Up[id] = timings.runtimeUp;
+  Blinds_Runtime_Down[id] = timings.runtimeDown;
+  return true;
+}
+
+void speedStep(int id, int64_t now)
+{ // wypełnienie PWM jadącej rolety w stronę nastawienia prędkości, rampa od 0 do 100% w Speed_Ramp_Ms
+  // każda zmiana wypełnienia zaczyna nowy odcinek jazdy - pozycja to suma odcinków ze stałą prędkością
+  BlindMotion& motion = Blinds_Motion[id];
+  if (Blinds_Speed_Pin[id] < 0 or motion.state == BLIND_CALIBRATING or motion.duty == motion.speed) return;
+  if (motion.speed != 100) motion.fullTravel = false; //pomiar czasu przejazdu tylko przy pełnym wypełnieniu
+  int ramp = Speed_Ramp_Ms;
+  float change = ramp > 0 ? (now - motion.segmentStart) / 1000.0f * 100 / ramp : 100;
+  motion.duty = motion.duty < motion.speed ? min(float(motion.speed), motion.duty + change) : max(float(motion.speed), motion.duty - change);
+  motion.startPosition += motion.direction * travelDistance(id, motion.direction, motion.velocity, now - motion.segmentStart);
+  motion.segmentStart = now;
+  motion.velocity = speedVelocity(id, motion.duty);
+  halSpeedWrite(Blinds_Speed_Pin[id], motion.duty / 100);
+}
+
+float speedVelocity(int id, float duty)
+{ // prędkość rolety przy wypełnieniu duty % jako ułamek prędkości pełnej - interpolacja kalibracji z API
+  // między punktami (0, 0) i (100, 100): czasy przejazdu są mierzone przy pełnym wypełnieniu
+  if (Blinds_Speed_Pin[id] < 0) return 1;
+  SpeedTable table = Blinds_Speed_Table[id].read();
+  float lowDuty = 0;
+  float lowVelocity = 0;
+  for (int i=0; i <= table.count; i++)
+  {
+    float highDuty = i < table.count ? table.duty[i] : 100;
+    float highVelocity = i < table.count ? table.velocity[i] : 100;
+    if (duty <= highDuty)
+    {
+      return (lowVelocity + (duty - lowDuty) * (highVelocity - lowVelocity) / (highDuty - lowDuty)) / 100;
+    }
+    lowDuty = highDuty;
+    lowVelocity = highVelocity;
+  }
+  return 1;
+}
+
+void homeBlind(int id, int direction, float estimate, int64_t now, bool moving)
+{ // krańcówka w kierunku direction: korekta pozycji, statystyka dryfu, po pełnym przejeździe korekta czasu przejazdu,
+  // potem docisk przez czas pass (tylko jadąca roleta z nastawieniem krańcowym) lub zatrzymanie
+  BlindMotion& motion = Blinds_Motion[id];
+  float endstop = direction < 0 ? 0 : 100;
+  float drift = estimate - endstop; //dodatni w górę i ujemny w dół - roleta szybsza niż z czasu przejazdu
+  motion.drift = drift;
+  motion.homings++;
+  motion.driftSum += fabsf(drift);
+  motion.driftMax = max(motion.driftMax, fabsf(drift));
+  if (motion.fullTravel and fabsf(drift) <= Runtime_Adjust_Max)
+  { //rzeczywisty czas pełnego przejazdu to runtime * (100 + direction * drift) / 100 - zapis w NVS i API (apiUpdatePosition)
+    int& runtime = direction < 0 ? Blinds_Runtime_Up[id] : Blinds_Runtime_Down[id];
+    runtime = lroundf(runtime * (1 + Runtime_Adjust_Gain * direction * drift / 100));
+    motion.calibrations++;
+  }
+  motion.fullTravel = false;
+  motion.position = endstop;
+  motion.homed = direction;
+
+  int pass = direction < 0 ? Blinds_Pass_Up[id] : Blinds_Pass_Down[id];
+  if (moving and pass > 0 and motion.set == endstop)
+  {
+    motion.state = BLIND_PASS;
+    motion.moveStart = now;
+    motion.segmentStart = now;
+    motion.startPosition = endstop;
+  }
+  else
+  {
+    stopMotor(id);
+  }
+}
+
+float travelDistance(int id, int direction, float velocity, int64_t elapsedUs)
+{ // droga rolety w % po elapsedUs pracy silnika w kierunku direction (-1 w górę, 1 w dół) z prędkością velocity
+  float runtime = direction < 0 ? Blinds_Runtime_Up[id] : Blinds_Runtime_Down[id];
+  return velocity * (elapsedUs / 1000.0) * 100 / max(runtime, 1.0f);
+}
+
+void publishBlinds(void* parameters)
+{ // publikowanie położenia rolet ze zdarzeń silnika ruchu (Blinds_Events), łączonych osobno dla każdej rolety:
+  // stop i krańcówka od razu, start (nowe nastawienie) najwyżej co Publish_Interval_Ms, postęp jazdy dodatkowo
+  // przy zmianie o Publish_Step %; ostatnia pozycja zawsze trafia do brokera (wiadomość zachowana)
+  // obok ssh/blinds/run/<id> wiadomość ruchu ssh/blinds/motion/<id>: zamiar jazdy przy starcie i stan końcowy przy stopie
+  typedef struct {
+    int step; //ostatnio opublikowana pozycja w %
+    int set; //ostatnio opublikowane nastawienie
+    unsigned long publishedMs; //czas ostatniej publikacji
+    bool pending; //stan do opublikowania
+    bool started; //wśród połączonych zdarzeń jest start - publikacja bez względu na Publish_Step
+    bool stopped; //wśród połączonych zdarzeń jest stop lub krańcówka - publikacja od razu
+    int pendingStep;
+    int pendingSet;
+    bool moving; //zamiar jazdy opublikowany lub oczekujący - stop zamknie go wiadomością końcową
+    bool lostStop; //stop zastępczy po utraconym zdarzeniu - ponowiony stop silnika ruchu poprawi wiadomość końcową
+    bool motionPending; //wiadomość ruchu do opublikowania
+    unsigned long motionPublishedMs; //czas ostatniej publikacji zamiaru jazdy
+    BlindEvent motion; //zdarzenie do wiadomości ruchu - start lub stop
+  } BlindPublish;
+  BlindPublish blinds[Blinds_Max] = {};
+
+  for (int i=0; i < Blinds_Count; i++)
+  {
+    BlindSnapshot snapshot = Blinds_State[i].read();
+    blinds[i].step = int(snapshot.position);
+    blinds[i].set = snapshot.set;
+  }
+
+  while (true)
+  {
+    BlindEvent event;
+    while (Blinds_Events.pop(&event))
+    {
+      BlindPublish& blind = blinds[event.blind];
+      blind.pendingStep = int(event.position);
+      blind.pendingSet = event.set;
+      blind.pending = true;
+      blind.started |= event.type == BLIND_EVENT_START;
+      blind.stopped |= event.type == BLIND_EVENT_STOP or event.type == BLIND_EVENT_ENDSTOP;
+      if (event.type == BLIND_EVENT_START or (event.type != BLIND_EVENT_PROGRESS and (blind.moving or blind.lostStop)))
+      { //nowszy zamiar jazdy zastępuje oczekujący
+        blind.motion = event;
+        blind.motionPending = true;
+        blind.moving = event.type == BLIND_EVENT_START;
+        blind.lostStop = false;
+      }
+    }
+    uint32_t lost = Blinds_Events_Lost.exchange(0);
+    for (int i=0; i < Blinds_Count; i++)
+    {
+      if (lost & (1u << i))
+      { //zdarzenie przepadło przy pełnej kolejce - aktualny stan z silnika ruchu
+        BlindSnapshot snapshot = Blinds_State[i].read();
+        blinds[i].pendingStep = int(snapshot.position);
+        blinds[i].pendingSet = snapshot.set;
+        blinds[i].pending = true;
+        blinds[i].stopped = true;
+        if (blinds[i].moving)
+        { //jadąca roleta ponowi start w kolejnym ticku
+          BlindEvent& motion = blinds[i].motion;
+          motion.type = BLIND_EVENT_STOP;
+          motion.direction = 0;
+          motion.position = snapshot.position;
+          motion.time = esp_timer_get_time();
+          blinds[i].motionPending = true;
+          blinds[i].moving = false;
+          blinds[i].lostStop = true;
+        }
+      }
+    }
+
+    unsigned long now = millis();
+    int interval = Publish_Interval_Ms;
+    int stepSize = Publish_Step;
+    bool connected = halMqttConnected();
+    int waitMs = -1; //najbliższa publikacja odłożona w czasie, -1 = czekanie na zdarzenie
+    for (int i=0; i < Blinds_Count; i++)
+    {
+      BlindPublish& blind = blinds[i];
+      if (!blind.pending) continue;
+      if (blind.pendingStep == blind.step and blind.pendingSet == blind.set)
+      {
+        blind.pending = false;
+        blind.started = false;
+        blind.stopped = false;
+        continue;
+      }
+      if (!blind.stopped and !blind.started and abs(blind.pendingStep - blind.step) < stepSize) continue; //zastąpi go kolejne zdarzenie
+      int due = blind.stopped ? 0 : interval - int(now - blind.publishedMs);
+      if (!connected or due > 0)
+      {
+        int delay = connected ? due : Publish_Retry_Ms;
+        waitMs = waitMs < 0 ? delay : min(waitMs, delay);
+        continue;
+      }
+
+      char topic[32];
+      char message[64];
+      snprintf(topic, sizeof(topic), "ssh/blinds/run/%d", Blinds_Id[i]);
+      snprintf(message, sizeof(message), "{\"id\": %d, \"set\": %d, \"step\": %d}", Blinds_Id[i], blind.pendingSet, blind.pendingStep);
+      if (halMqttPublish(topic, message, true)) //wysłanie informacji o zmienie pozycji rolety
+      {
+        blind.step = blind.pendingStep;
+        blind.set = blind.pendingSet;
+        blind.publishedMs = now;
+        blind.pending = false;
+        blind.started = false;
+        blind.stopped = false;
+      }
+      else
+      {
+        Serial.println("MQTT publish fail!");
+        waitMs = waitMs < 0 ? Publish_Retry_Ms : min(waitMs, Publish_Retry_Ms);
+      }
+    }
+
+    for (int i=0; i < Blinds_Count; i++)
+    { //wiadomość ruchu: stop od razu, zamiar jazdy najwyżej co Publish_Interval_Ms (seria zmian nastawienia - ostatni zamiar)
+      BlindPublish& blind = blinds[i];
+      if (!blind.motionPending) continue;
+      bool start = blind.motion.type == BLIND_EVENT_START;
+      int due = start ? interval - int(now - blind.motionPublishedMs) : 0;
+      if (!connected or due > 0)
+      {
+        int delay = connected ? due : Publish_Retry_Ms;
+        waitMs = waitMs < 0 ? delay : min(waitMs, delay);
+        continue;
+      }
+      if (publishMotion(i, blind.motion, eventUnixMs(blind.motion.time)))
+      {
+        blind.motionPending = false;
+        if (start) blind.motionPublishedMs = now;
+      }
+      else
+      {
+        Serial.println("MQTT publish fail!");
+        waitMs = waitMs < 0 ? Publish_Retry_Ms : min(waitMs, Publish_Retry_Ms);
+      }
+    }
+    ulTaskNotifyTake(pdTRUE, waitMs < 0 ? portMAX_DELAY : pdMS_TO_TICKS(waitMs));
+  }
+}
+
+bool publishMotion(int id, const BlindEvent& event, int64_t timestamp)
+{ // ssh/blinds/motion/<id> (wiadomość zachowana) - odbiorca animuje pozycję sam, bez strumienia ssh/blinds/run/<id>:
+  // start: {"id": 3, "moving": true, "from": 12.50, "to": 100, "direction": 1, "start": <unix ms>, "duration": <ms>}
+  // stop: {"id": 3, "moving": false, "position": 100.00, "endstop": true, "stop": <unix ms>, "drift": -0.42}
+  // drift - błąd pozycji z modelu ruchu skorygowany na krańcówce w tej jeździe w % (brak pola bez krańcówki)
+  // duration - przejazd from -> to z czasów Blinds_Runtime_Up/Down i kalibracji prędkości, bez rampy i dojazdu do krańcówki
+  char topic[40];
+  char message[160];
+  snprintf(topic, sizeof(topic), "ssh/blinds/motion/%d", Blinds_Id[id]);
+  if (event.type == BLIND_EVENT_START)
+  {
+    BlindSnapshot snapshot = Blinds_State[id].read();
+    int runtime = event.direction < 0 ? snapshot.runtimeUp : snapshot.runtimeDown;
+    float velocity = max(speedVelocity(id, event.speed), 0.01f);
+    long duration = lroundf(fabsf(event.target - event.position) * runtime / 100 / velocity);
+    snprintf(message, sizeof(message), "{\"id\": %d, \"moving\": true, \"from\": %.2f, \"to\": %d, \"direction\": %d, \"start\": %lld, \"duration\": %ld}",
+      Blinds_Id[id], event.position, event.target, event.direction, (long long)timestamp, duration);
+  }
+  else
+  {
+    int length = snprintf(message, sizeof(message), "{\"id\": %d, \"moving\": false, \"position\": %.2f, \"endstop\": %s, \"stop\": %lld",
+      Blinds_Id[id], event.position, event.type == BLIND_EVENT_ENDSTOP ? "true" : "false", (long long)timestamp);
+    if (!isnan(event.drift)) length += snprintf(message + length, sizeof(message) - length, ", \"drift\": %.2f", event.drift);
+    snprintf(message + length, sizeof(message) - length, "}");
+  }
+  return halMqttPublish(topic, message, true);
+}
+
+int64_t eventUnixMs(int64_t us)
+{ // czas zdarzenia silnika ruchu (esp_timer_get_time) jako czas uniksowy w ms - zegar NTP
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return int64_t(now.tv_sec) * 1000 + now.tv_usec / 1000 - (esp_timer_get_time() - us) / 1000;
+}
+
+void mcpLoop(void* parameters)
+{ // funkcja ustawiająca MCP23017 zgodnie ze zmiennymi
+  // utworzone w ten sposób aby tylko pojedyncze zadanie komunikowało się z MCP
+  // w każdym cyklu jeden odczyt GPIOAB, zapis wyjść tylko przy zmianie maski
+  // cykl wyzwalany przerwaniem krańcówki lub zmianą kierunku silników w ticku motionTick,
+  // odczyt kontrolny co Mcp_Moving_Poll / Mcp_Idle_Poll ms
+  // przy kilku układach w każdym cyklu jeden odczyt GPIOAB na układ, przerwania wszystkich układów na wspólnej linii
+  uint16_t sensorPins[Mcp_Max] = {};
+  for (int i=0; i < Blinds_Count; i++)
+  {
+    sensorPins[Blinds_Chip[i]] |= (1u << Mcp_Sensor_Up_Pin[i]) | (1u << Mcp_Sensor_Down_Pin[i]);
+  }
+  for (int chip=0; chip < Mcp_Count; chip++)
+  {
+    if (Mcp_Chips & (1u << chip)) halMcpSetupInterrupts(chip, sensorPins[chip], mcpInterrupt);
+  }
+
+  uint16_t written[Mcp_Max] = {}; //ostatnio zapisana maska wyjść każdego układu
+  bool outputsWritten = false;
+  uint32_t rateTransactions = halMcpTransactions();
+  unsigned long rateStart = millis();
+  int64_t pollDue = -1; //koniec oczekiwania na wybudzenie - planowany start cyklu bez wybudzenia
+
+  while (true)
+  {
+    int64_t cycleStart = esp_timer_get_time();
+    uint32_t wake = Mcp_Wake_Us.exchange(0);
+    Mcp_Metrics.begin(cycleStart, wake != 0 ? cycleStart - int32_t(uint32_t(cycleStart) - wake) : pollDue);
+
+    uint16_t inputs[Mcp_Max] = {};
+    bool changed = false;
+    for (int chip=0; chip < Mcp_Count; chip++)
+    {
+      if (!(Mcp_Chips & (1u << chip))) continue;
+      int64_t start = esp_timer_get_time();
+      inputs[chip] = halMcpReadGPIOAB(chip);
+      I2c_Time.record(esp_timer_get_time() - start);
+      changed |= (inputs[chip] ^ Mcp_Inputs[chip]) & sensorPins[chip];
+      Mcp_Inputs[chip] = inputs[chip];
+    }
+
+    uint16_t outputs[Mcp_Max];
+    bool moving = false;
+    for (int chip=0; chip < Mcp_Count; chip++)
+    {
+      outputs[chip] = Mcp_Requested[chip];
+    }
+    for (int i=0; i < Blinds_Count; i++)
+    {
+      // przekaźnik wyłączany od razu po osiągnięciu krańcówki, bez czekania na silnik ruchu
+      // poza jazdą za krańcówkę (Mcp_Pass) - tę kończy silnik ruchu po czasie pass
+      uint16_t locked = ~Mcp_Pass[Blinds_Chip[i]];
+      if (sensorUp(i, inputs)) { outputs[Blinds_Chip[i]] &= ~(locked & (1u << Mcp_Up_Pin[i])); }
+      if (sensorDown(i, inputs)) { outputs[Blinds_Chip[i]] &= ~(locked & (1u << Mcp_Down_Pin[i])); }
+    }
+
+    for (int chip=0; chip < Mcp_Count; chip++)
+    {
+      if (!(Mcp_Chips & (1u << chip))) continue;
+      if (!outputsWritten or outputs[chip] != written[chip])
+      {
+        int64_t start = esp_timer_get_time();
+        halMcpWriteGPIOAB(chip, outputs[chip]);
+        I2c_Time.record(esp_timer_get_time() - start);
+        written[chip] = outputs[chip];
+      }
+      moving |= outputs[chip] != 0;
+    }
+    outputsWritten = true;
+
+    if (changed)
+    {
+      motionWake();
+    }
+
+    unsigned long now = millis();
+    if (now - rateStart >= 1000)
+    {
+      uint32_t transactions = halMcpTransactions();
+      Mcp_I2C_Rate = (transactions - rateTransactions) * 1000 / (now - rateStart);
+      rateTransactions = transactions;
+      rateStart = now;
+    }
+    int poll = moving ? Mcp_Moving_Poll : Mcp_Idle_Poll;
+    int64_t cycleEnd = esp_timer_get_time();
+    Mcp_Metrics.end(cycleEnd);
+    pollDue = cycleEnd + poll * 1000LL;
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(poll));
+  }
+}
+
+void IRAM_ATTR mcpWakeMark()
+{ // chwila wybudzenia mcpLoop do pomiaru opóźnienia cyklu - pierwsze wybudzenie od poprzedniego cyklu
+  uint32_t expected = 0;
+  Mcp_Wake_Us.compare_exchange_strong(expected, uint32_t(esp_timer_get_time()) | 1);
+}
+
+void IRAM_ATTR mcpInterrupt()
+{ // przerwanie INTA/INTB MCP23017 - zmiana stanu krańcówki, odczyt w mcpLoop
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  if (Mcp_Task != NULL)
+  {
+    mcpWakeMark();
+    vTaskNotifyGiveFromISR(Mcp_Task, &higherPriorityTaskWoken);
+  }
+  portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+void setMotor(int id, bool up, bool down)
+{ // ustawienie kierunku silnika rolety - motionTick wybudza mcpLoop po ostatniej rolecie ticku
+  std::atomic<uint16_t>& requested = Mcp_Requested[Blinds_Chip[id]];
+  uint16_t pins = (1u << Mcp_Up_Pin[id]) | (1u << Mcp_Down_Pin[id]);
+  requested = (requested & ~pins) | (up ? 1u << Mcp_Up_Pin[id] : 0) | (down ? 1u << Mcp_Down_Pin[id] : 0);
+}
+
+void setPass(int id)
+{ // zgoda na jazdę za krańcówkę dla mcpLoop: roleta jedzie do krańcówki z takim nastawieniem i niezerowym czasem pass
+  // - przekaźnik nie jest wyłączany na krańcówce, a silnik ruchu przechodzi w BLIND_PASS bez zatrzymania silnika
+  BlindMotion& motion = Blinds_Motion[id];
+  int endstop = motion.direction < 0 ? 0 : 100;
+  int pass = motion.direction < 0 ? Blinds_Pass_Up[id] : Blinds_Pass_Down[id];
+  bool allowed = motion.direction != 0 and motion.state != BLIND_CALIBRATING and pass > 0 and motion.set == endstop and motion.target == endstop;
+  std::atomic<uint16_t>& passPins = Mcp_Pass[Blinds_Chip[id]];
+  uint16_t pins = (1u << Mcp_Up_Pin[id]) | (1u << Mcp_Down_Pin[id]);
+  passPins = (passPins & ~pins) | (allowed ? 1u << (motion.direction < 0 ? Mcp_Up_Pin[id] : Mcp_Down_Pin[id]) : 0);
+}
+
+void nvsUpdateInt(const char* key, int32_t value)
+{ // zapis tylko zmienionej wartości - bez zbędnych zapisów flash
+  int32_t stored;
+  if (!halNvsGetInt(key, &stored) or stored != value) halNvsSetInt(key, value);
+}
+
+void nvsUpdateString(const char* key, const char* value)
+{
+  static char stored[Nvs_String_Size]; //zapisy NVS tylko z apiGetConfig - jedno zadanie naraz
+  if (!halNvsGetString(key, stored, sizeof(stored)) or strcmp(stored, value) != 0) halNvsSetString(key, value);
+}
+
+bool loadBootCache()
+{ // ostatnia dobra konfiguracja MQTT, czasy przejazdu i pozycje rolet z NVS - start bez czekania na API
+  static char ntpServer[64]; //SNTP przechowuje wskaźnik do nazwy serwera
+  const char* blindKeys[5] = {"rtu", "rtd", "psu", "psd", "last"};
+  int32_t blinds[Blinds_Max][5];
+  char server[64];
+  char user[64];
+  char password[64];
+  int32_t version;
+  int32_t port;
+  char key[16];
+
+  if (!halNvsGetInt("cache", &version) or version != Boot_Cache_Version) return false;
+  for (int i=0; i < Blinds_Count; i++)
+  {
+    for (int k=0; k < 5; k++)
+    {
+      snprintf(key, sizeof(key), "%s%d", blindKeys[k], Blinds_Id[i]);
+      if (!halNvsGetInt(key, &blinds[i][k])) return false;
+    }
+  }
+  if (!halNvsGetString("mqtt_server", server, sizeof(server)) or !halNvsGetInt("mqtt_port", &port)
+    or !halNvsGetString("mqtt_user", user, sizeof(user)) or !halNvsGetString("mqtt_password", password, sizeof(password))) return false;
+
+  Mqtt_Server = server;
+  Mqtt_Port = port;
+  Mqtt_User = user;
+  Mqtt_Password = password;
+  if (halNvsGetString("ntp_server", ntpServer, sizeof(ntpServer)))
+  {
+    configTime(7200, 0, ntpServer, "ntp.certum.pl");
+  }
+  char groups[Nvs_String_Size];
+  if (halNvsGetString("groups", groups, sizeof(groups)))
+  {
+    loadGroups(groups);
+  }
+  int32_t publish;
+  if (halNvsGetInt("pub_interval", &publish)) Publish_Interval_Ms = publish;
+  if (halNvsGetInt("pub_step", &publish)) Publish_Step = publish;
+  int32_t pwm;
+  if (halNvsGetInt("pwm_freq", &pwm)) Pwm_Frequency = pwm;
+  if (halNvsGetInt("pwm_res", &pwm)) Pwm_Resolution = pwm;
+  if (halNvsGetInt("speed_ramp", &pwm)) Speed_Ramp_Ms = pwm;
+  for (int i=0; i < Blinds_Count; i++)
+  {
+    Blinds_Runtime_Up[i] = blinds[i][0];
+    Blinds_Runtime_Down[i] = blinds[i][1];
+    Blinds_Pass_Up[i] = blinds[i][2];
+    Blinds_Pass_Down[i] = blinds[i][3];
+    int32_t pending;
+    snprintf(key, sizeof(key), "rtp%d", Blinds_Id[i]);
+    if (halNvsGetInt(key, &pending)) Blinds_Motion[i].calibrations = 1; //czasy przejazdu niewysłane przed restartem - nowsze niż w API
+    Blinds_Motion[i].position = blinds[i][4];
+    Blinds_Set[i] = blinds[i][4];
+    publishState(i);
+    char table[Speed_Table_Max * 8 + 1];
+    SpeedTable speedTable;
+    snprintf(key, sizeof(key), "spd%d", Blinds_Id[i]);
+    if (halNvsGetString(key, table, sizeof(table)) and parseSpeedTable(table, &speedTable)) Blinds_Speed_Table[i].write(speedTable);
+  }
+  Serial.println("Konfiguracja i stan rolet z NVS");
+  return true;
+}
+
+void journalLoop(void* parameters)
+{ // zapis stanu rolet w dzienniku flash - poza silnikiem ruchu, bo zapis i kasowanie flash trwają milisekundy
+  // tylko najnowszy stan każdej rolety, serie zapisów nie częściej niż co Journal_Write_Interval_Ms
+  JournalEntry written[Blinds_Max];
+  for (int i=0; i < Blinds_Count; i++)
+  {
+    written[i] = Journal_State[i].read();
+  }
+  journalPrepare(written);
+
+  while (true)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    for (int i=0; i < Blinds_Count; i++)
+    {
+      JournalEntry entry = Journal_State[i].read();
+      if (memcmp(&entry, &written[i], sizeof(entry)) == 0) continue;
+      written[i] = entry;
+      bool saved = true;
+      if (Journal.sectorStart())
+      { //nowy sektor zaczyna się stanem wszystkich rolet - skasowanie najstarszego sektora nie gubi pozycji
+        for (int j=0; j < Blinds_Count; j++)
         {
-          String url = API_URL + "/blinds/" + String(Blinds_Id[i]) + "/";
-          String payload = "{\"position\":" + String(int(Blinds_Position[i])) + "}";
+          saved &= Journal.append(written[j]);
+        }
+      }
+      else
+      {
+        saved = Journal.append(entry);
+      }
+      if (!saved)
+      {
+        Serial.println("Błąd zapisu dziennika flash");
+      }
+    }
+    journalPrepare(written);
+    vTaskDelay(pdMS_TO_TICKS(Journal_Write_Interval_Ms));
+  }
+}
 
-          HTTPClient httpClient;
-          httpClient.begin(url);
-          httpClient.addHeader("Content-Type", "application/json");
-          httpClient.addHeader("Authorization", "Bearer " + accessToken);
-          int httpResponseCode = httpClient.PATCH(payload);
+void journalPrepare(const JournalEntry* written)
+{ // kasowanie sektorów dziennika z wyprzedzeniem - tylko gdy wszystkie rolety stoją: kasowanie wstrzymuje
+  // pamięć podręczną flash obu rdzeni na kilkadziesiąt ms (do kilkuset ms), a z nim tick ruchu i odcięcie na krańcówce
+  // roleta ruszająca w trakcie kasowania startuje z opóźnieniem, pozycja z esp_timer pozostaje dokładna
+  while (true)
+  {
+    for (int i=0; i < Blinds_Count; i++)
+    {
+      JournalEntry entry = Journal_State[i].read();
+      if (entry.direction != 0 or entry.calibrating or memcmp(&entry, &written[i], sizeof(entry)) != 0) return; //jazda albo stan jeszcze niezapisany
+    }
+    if (!Journal.prepare(Journal_Prepared_Sectors)) return;
+  }
+}
 
-          if (httpResponseCode > 0) 
-          {
-            if (httpResponseCode == 200)
-            {
-              String response = httpClient.getString();
-              // Serial.println(response);
-              httpClient.end();
-              Blinds_Api_Position[i] = Blinds_Position[i];
-              // Serial.println("PATCH position success");
-              vTaskDelay(pdMS_TO_TICKS(200));
-              break;
-            }
-            else
-            {
-              Serial.print("API Error code: ");
-              Serial.println(httpResponseCode);
-            }
-          }
-          else
+void journalRestore()
+{ // pozycje rolet z dziennika flash są aktualniejsze niż NVS i API - dokładne po zatrzymaniu,
+  // a przy utracie zasilania w trakcie jazdy szacowane z ostatniego wpisu (błąd do połowy okresu wpisów)
+  JournalEntry latest[Blinds_Max];
+  bool found[Blinds_Max] = {};
+  if (Journal.begin())
+  {
+    Journal.replay([&](const JournalEntry& entry) {
+      int i = Blinds_Index[entry.blind]; //wpisy rolet usuniętych z okablowania pomijane
+      if (i >= 0)
+      {
+        latest[i] = entry;
+        found[i] = true;
+      }
+    });
+  }
+  else
+  {
+    Serial.println("Brak obszaru dziennika we flash");
+  }
+
+  for (int i=0; i < Blinds_Count; i++)
+  {
+    BlindMotion& motion = Blinds_Motion[i];
+    if (!found[i])
+    {
+      motion.journal.position = lroundf(motion.position * 100);
+      motion.journal.blind = Blinds_Id[i];
+      motion.journal.target = lroundf(motion.position);
+      Journal_State[i].write(motion.journal);
+      continue;
+    }
+
+    JournalEntry entry = latest[i];
+    motion.journal = entry; //pierwszy tick zapisze stan po odtworzeniu
+    Journal_State[i].write(entry);
+    if (entry.calibrating)
+    {
+      Serial.printf("Kalibracja rolety nr %d przerwana restartem - ponowna kalibracja\n", Blinds_Id[i]);
+      Blinds_Calibrate_Request[i]++;
+      continue;
+    }
+
+    float position = entry.position / 100.0;
+    if (entry.direction != 0)
+    { //od ostatniego wpisu do utraty zasilania minęło od 0 do Journal_Checkpoint_Ms + Journal_Write_Interval_Ms - środek przedziału
+      float runtime = entry.direction < 0 ? Blinds_Runtime_Up[i] : Blinds_Runtime_Down[i];
+      position += entry.direction * (Journal_Checkpoint_Ms + Journal_Write_Interval_Ms) / 2.0 * 100 / max(runtime, 1.0f);
+      position = entry.direction < 0 ? max(position, float(entry.target)) : min(position, float(entry.target));
+      Serial.printf("Roleta nr %d zatrzymana utratą zasilania w trakcie jazdy, pozycja szacowana: %.1f\n", Blinds_Id[i], position);
+    }
+    int restored = lroundf(position);
+    motion.position = restored;
+    Blinds_Set[i] = restored;
+    publishState(i);
+    char key[16];
+    snprintf(key, sizeof(key), "last%d", Blinds_Id[i]);
+    nvsUpdateInt(key, restored);
+  }
+}
+
+void restorePendingPositions()
+{ // pozycje niewysłane do API przed restartem są aktualniejsze niż odczytane z API
+  for (int i=0; i < Blinds_Count; i++)
+  {
+    int32_t position;
+    char key[16];
+    snprintf(key, sizeof(key), "pos%d", Blinds_Id[i]);
+    if (halNvsGetInt(key, &position) and position >= 0 and position <= 100)
+    {
+      Serial.printf("Pozycja rolety nr %d z NVS: %d\n", Blinds_Id[i], (int)position);
+      Blinds_Motion[i].position = position;
+      Blinds_Set[i] = position;
+      publishState(i);
+      snprintf(key, sizeof(key), "last%d", Blinds_Id[i]);
+      nvsUpdateInt(key, position);
+    }
+  }
+}
+
+void apiUpdatePosition(void* parameters)
+{ // kolejka write-behind pozycji rolet do API
+  // tylko najnowsza pozycja zatrzymanej rolety, wysyłane seriami po jednym połączeniu keep-alive,
+  // przy błędzie wykładniczy backoff, a niewysłane pozycje w NVS (wysyłane po restarcie)
+  // ostatnia pozycja i wyniki kalibracji trafiają do NVS niezależnie od API - z nich startuje kolejne uruchomienie
+  bool synced = false; //stan API znany (Api_Synced)
+  static int sentPosition[Blinds_Max]; //stan zadania poza stosem (jedno zadanie) - ostatnia pozycja potwierdzona przez API
+  static int storedPosition[Blinds_Max]; //pozycja zapisana w NVS, -1 brak
+  static int cachedPosition[Blinds_Max]; //pozycja zapisana w NVS jako stan startowy ("last")
+  static uint32_t sentCalibrations[Blinds_Max];
+  static bool storedCalibrations[Blinds_Max]; //znacznik niewysłanych czasów przejazdu w NVS ("rtp")
+  static int cachedTimings[Blinds_Max][4]; //czasy przejazdu i pass zapisane w NVS (stan startowy)
+  const char* timingKeys[4] = {"rtu", "rtd", "psu", "psd"};
+  uint32_t backoff = 0;
+  TickType_t failedAt = 0;
+  static char url[Api_Url_Size]; //bufory zadania - żądania budowane bez sterty
+  static char payload[64];
+  char key[16];
+
+  for (int i=0; i < Blinds_Count; i++)
+  {
+    int32_t position;
+    BlindSnapshot blind = Blinds_State[i].read();
+    snprintf(key, sizeof(key), "pos%d", Blinds_Id[i]);
+    storedPosition[i] = halNvsGetInt(key, &position) ? position : -1;
+    cachedPosition[i] = blind.set;
+    sentCalibrations[i] = Blinds_Calibrations_Confirmed[i]; //czasy niewysłane przed restartem (loadBootCache) wysyłane od razu
+    snprintf(key, sizeof(key), "rtp%d", Blinds_Id[i]);
+    storedCalibrations[i] = halNvsGetInt(key, &position);
+    for (int k=0; k < 4; k++) cachedTimings[i][k] = -1; //pierwsze porównanie z NVS w nvsUpdateInt
+  }
+
+  while (true)
+  {
+    if (!synced and Api_Synced)
+    { // pozycje zmienione przed synchronizacją porównywane ze stanem API
+      synced = true;
+      for (int i=0; i < Blinds_Count; i++)
+      {
+        sentPosition[i] = Blinds_Api_Position[i];
+      }
+    }
+    bool sendAllowed = synced and (backoff == 0 or xTaskGetTickCount() - failedAt >= pdMS_TO_TICKS(backoff));
+    bool failed = false;
+
+    for (int i=0; i < Blinds_Count; i++)
+    {
+      BlindSnapshot blind = Blinds_State[i].read(); //pozycja, nastawienie i czasy przejazdu z jednego ticku
+      snprintf(url, sizeof(url), "%s/blinds/%d/", API_URL.c_str(), Blinds_Id[i]);
+
+      int timings[4] = {blind.runtimeUp, blind.runtimeDown, blind.passUp, blind.passDown};
+      for (int k=0; k < 4; k++)
+      { // czasy z kalibracji, korekt i API - z NVS startuje kolejne uruchomienie
+        if (timings[k] == cachedTimings[i][k]) continue;
+        snprintf(key, sizeof(key), "%s%d", timingKeys[k], Blinds_Id[i]);
+        nvsUpdateInt(key, timings[k]);
+        cachedTimings[i][k] = timings[k];
+      }
+
+      if (sentCalibrations[i] != blind.calibrations and sendAllowed and !failed)
+      { // wyniki kalibracji zmierzone przez silnik ruchu
+        snprintf(payload, sizeof(payload), "{\"runtime_up\": %d, \"runtime_down\": %d}", blind.runtimeUp, blind.runtimeDown);
+        int httpResponseCode = apiRequest("PATCH", url, payload, accessToken, NULL);
+
+        if (httpResponseCode == 200)
+        {
+          sentCalibrations[i] = blind.calibrations;
+          Blinds_Calibrations_Confirmed[i] = blind.calibrations;
+          if (storedCalibrations[i])
           {
-            Serial.print("API Error on sending PATCH: ");
-            Serial.println(httpResponseCode);
+            snprintf(key, sizeof(key), "rtp%d", Blinds_Id[i]);
+            halNvsRemove(key);
+            storedCalibrations[i] = false;
           }
-          httpClient.end();
+          Serial.print("Wyniki kalibracji rolety nr ");
+          Serial.print(Blinds_Id[i]);
+          Serial.println(":");
+          Serial.print("Przejazd w dół: ");
+          Serial.println(blind.runtimeDown);
+          Serial.print("Przejazd w górę: ");
+          Serial.println(blind.runtimeUp);
+        }
+        else
+        {
+          Serial.print("API Error on sending calibration PATCH: ");
+          Serial.println(httpResponseCode);
+          failed = true;
         }
       }
-      vTaskDelay(pdMS_TO_TICKS(10));
+
+      if (sentCalibrations[i] != blind.calibrations and !storedCalibrations[i])
+      { // niewysłane czasy przejazdu przetrwają restart - po nim nie nadpisze ich odczyt z API
+        snprintf(key, sizeof(key), "rtp%d", Blinds_Id[i]);
+        halNvsSetInt(key, 1);
+        storedCalibrations[i] = true;
+      }
+
+      if (blind.set != blind.position) continue; //roleta w ruchu - do kolejki trafi pozycja końcowa
+      int position = blind.set;
+      if (position != cachedPosition[i])
+      {
+        snprintf(key, sizeof(key), "last%d", Blinds_Id[i]);
+        halNvsSetInt(key, position);
+        cachedPosition[i] = position;
+      }
+      if (!synced) continue;
+      snprintf(key, sizeof(key), "pos%d", Blinds_Id[i]);
+
+      if (position != sentPosition[i] and sendAllowed and !failed)
+      {
+        snprintf(payload, sizeof(payload), "{\"position\":%d}", position);
+        int httpResponseCode = apiRequest("PATCH", url, payload, accessToken, NULL);
+        if (httpResponseCode == 200)
+        {
+          sentPosition[i] = position;
+        }
+        else
+        {
+          Serial.print("API Error on sending PATCH: ");
+          Serial.println(httpResponseCode);
+          failed = true;
+        }
+      }
+
+      if (position != sentPosition[i] and storedPosition[i] != position)
+      { // niewysłana pozycja przetrwa restart
+        halNvsSetInt(key, position);
+        storedPosition[i] = position;
+      }
+      else if (position == sentPosition[i] and storedPosition[i] >= 0)
+      {
+        halNvsRemove(key);
+        storedPosition[i] = -1;
+      }
+    }
+
+    if (failed)
+    {
+      backoff = backoff ? min(backoff * 2, (uint32_t)Api_Backoff_Max) : Api_Backoff_Min;
+      failedAt = xTaskGetTickCount();
     }
-    vTaskDelay(pdMS_TO_TICKS(10));
+    else if (sendAllowed)
+    {
+      backoff = 0;
+    }
+
+    TickType_t wait = portMAX_DELAY;
+    if (backoff)
+    {
+      TickType_t elapsed = xTaskGetTickCount() - failedAt;
+      wait = elapsed < pdMS_TO_TICKS(backoff) ? pdMS_TO_TICKS(backoff) - elapsed : 0;
+    }
+    ulTaskNotifyTake(pdTRUE, wait); //zatrzymanie rolety w trakcie backoff tylko aktualizuje NVS
   }
-}
\ No newline at end of file
+}